@@ -188,6 +188,7 @@ enum asEEngineProp
 	asEP_JIT_INTERFACE_VERSION              = 35,
 	asEP_ALWAYS_IMPL_DEFAULT_COPY           = 36,
 	asEP_ALWAYS_IMPL_DEFAULT_COPY_CONSTRUCT = 37,
+	asEP_FUSE_BYTECODE                      = 38,
 
 	asEP_LAST_PROPERTY
 };
@@ -982,6 +983,9 @@ public:
 	virtual int GetArgsOnStackCount(asUINT stackLevel) = 0;
 	virtual int GetArgOnStack(asUINT stackLevel, asUINT arg, int* typeId, asUINT *flags, void** address) = 0;
 
+	// Statistics
+	virtual void GetInterfaceCallCacheStats(asQWORD *hits, asQWORD *misses) const = 0;
+
 protected:
 	virtual ~asIScriptContext() {}
 };
@@ -1634,7 +1638,28 @@ enum asEBCInstr
 	asBC_POWi64			= 198,
 	asBC_POWu64			= 199,
 	asBC_Thiscall1		= 200,
-	asBC_MAXBYTECODE	= 201,
+
+	// Fused instructions. These take the place of the first instruction
+	// of the sequence they execute, and the rest of the sequence is kept
+	asBC_CmpIiJZ		= 201,
+	asBC_CmpIiJNZ		= 202,
+	asBC_CmpIiJS		= 203,
+	asBC_CmpIiJNS		= 204,
+	asBC_CmpIiJP		= 205,
+	asBC_CmpIiJNP		= 206,
+	asBC_CmpiJZ			= 207,
+	asBC_CmpiJNZ		= 208,
+	asBC_CmpiJS			= 209,
+	asBC_CmpiJNS		= 210,
+	asBC_CmpiJP			= 211,
+	asBC_CmpiJNP		= 212,
+	asBC_PshV4Call		= 213,
+	asBC_PshV4V4Call	= 214,
+	asBC_IncCmpIiJS		= 215,
+	asBC_IncCmpIiJNP	= 216,
+	asBC_IncCmpiJS		= 217,
+	asBC_IncCmpiJNP		= 218,
+	asBC_MAXBYTECODE	= 219,
 
 	// Temporary tokens. Can't be output to the final program
 	asBC_TryBlock		= 250,
@@ -1931,24 +1956,24 @@ const asSBCInfo asBCInfo[256] =
 	asBCINFO(POWu64,	wW_rW_rW_ARG,	0),
 	asBCINFO(Thiscall1, DW_ARG,			-AS_PTR_SIZE-1),
 
-	asBCINFO_DUMMY(201),
-	asBCINFO_DUMMY(202),
-	asBCINFO_DUMMY(203),
-	asBCINFO_DUMMY(204),
-	asBCINFO_DUMMY(205),
-	asBCINFO_DUMMY(206),
-	asBCINFO_DUMMY(207),
-	asBCINFO_DUMMY(208),
-	asBCINFO_DUMMY(209),
-	asBCINFO_DUMMY(210),
-	asBCINFO_DUMMY(211),
-	asBCINFO_DUMMY(212),
-	asBCINFO_DUMMY(213),
-	asBCINFO_DUMMY(214),
-	asBCINFO_DUMMY(215),
-	asBCINFO_DUMMY(216),
-	asBCINFO_DUMMY(217),
-	asBCINFO_DUMMY(218),
+	asBCINFO(CmpIiJZ,	rW_DW_ARG,		0),
+	asBCINFO(CmpIiJNZ,	rW_DW_ARG,		0),
+	asBCINFO(CmpIiJS,	rW_DW_ARG,		0),
+	asBCINFO(CmpIiJNS,	rW_DW_ARG,		0),
+	asBCINFO(CmpIiJP,	rW_DW_ARG,		0),
+	asBCINFO(CmpIiJNP,	rW_DW_ARG,		0),
+	asBCINFO(CmpiJZ,	rW_rW_ARG,		0),
+	asBCINFO(CmpiJNZ,	rW_rW_ARG,		0),
+	asBCINFO(CmpiJS,	rW_rW_ARG,		0),
+	asBCINFO(CmpiJNS,	rW_rW_ARG,		0),
+	asBCINFO(CmpiJP,	rW_rW_ARG,		0),
+	asBCINFO(CmpiJNP,	rW_rW_ARG,		0),
+	asBCINFO(PshV4Call,	rW_ARG,			1),
+	asBCINFO(PshV4V4Call, rW_ARG,		1),
+	asBCINFO(IncCmpIiJS, rW_ARG,		0),
+	asBCINFO(IncCmpIiJNP, rW_ARG,		0),
+	asBCINFO(IncCmpiJS,	rW_ARG,			0),
+	asBCINFO(IncCmpiJNP, rW_ARG,		0),
 	asBCINFO_DUMMY(219),
 	asBCINFO_DUMMY(220),
 	asBCINFO_DUMMY(221),
@@ -75,6 +75,9 @@ void asCByteCode::Finalize(const asCArray<int> &tempVariableOffsets)
 	// Optimize the code
 	Optimize();
 
+	// Combine frequently executed sequences of instructions
+	FuseInstructions();
+
 	// Resolve jumps
 	ResolveJumpAddresses();
 
@@ -1190,6 +1193,83 @@ void asCByteCode::Optimize()
 	}
 }
 
+void asCByteCode::FuseInstructions()
+{
+	// This function replaces the first instruction of some sequences that are executed very
+	// often with a fused instruction that executes the whole sequence, saving the dispatch of
+	// the instructions that follow. The rest of the sequence is kept as is, so the size of the
+	// code, the jump offsets, and the line numbers don't change, and a jump into the middle of
+	// the sequence still executes the remaining instructions one by one.
+
+	// Instructions that can suspend the execution, e.g. SUSPEND and JitEntry, are never part
+	// of a sequence, so the line callback still sees every statement
+
+	TimeIt("asCByteCode::FuseInstructions");
+
+	if( !engine->ep.optimizeByteCode || !engine->ep.fuseByteCode )
+		return;
+
+	// The JIT compiler only knows the regular instructions
+	if( engine->ep.includeJitInstructions )
+		return;
+
+	for( asCByteInstruction *curr = first; curr; curr = curr->next )
+	{
+		asCByteInstruction *next = GetNextOutputInstr(curr);
+		if( next == 0 )
+			break;
+
+		const asEBCInstr currOp = curr->op;
+		const asEBCInstr nextOp = next->op;
+		if( currOp == asBC_CMPIi || currOp == asBC_CMPi )
+		{
+			// CMPIi, Jxx -> CmpIiJxx
+			// CMPi, Jxx -> CmpiJxx
+			if( nextOp >= asBC_JZ && nextOp <= asBC_JNP )
+			{
+				asEBCInstr fused = currOp == asBC_CMPIi ? asBC_CmpIiJZ : asBC_CmpiJZ;
+				curr->op = asEBCInstr(fused + (nextOp - asBC_JZ));
+			}
+		}
+		else if( currOp == asBC_PshV4 )
+		{
+			// PshV4, CALL -> PshV4Call
+			if( nextOp == asBC_CALL )
+				curr->op = asBC_PshV4Call;
+			// PshV4, PshV4, CALL -> PshV4V4Call
+			else if( nextOp == asBC_PshV4 )
+			{
+				asCByteInstruction *call = GetNextOutputInstr(next);
+				if( call && call->op == asBC_CALL )
+					curr->op = asBC_PshV4V4Call;
+			}
+		}
+		else if( currOp == asBC_IncVi && (nextOp == asBC_CMPIi || nextOp == asBC_CMPi) )
+		{
+			// IncVi, CMPIi, JS -> IncCmpIiJS
+			// IncVi, CMPIi, JNP -> IncCmpIiJNP
+			// IncVi, CMPi, JS -> IncCmpiJS
+			// IncVi, CMPi, JNP -> IncCmpiJNP
+			asCByteInstruction *jump = GetNextOutputInstr(next);
+			if( jump && jump->op == asBC_JS )
+				curr->op = nextOp == asBC_CMPIi ? asBC_IncCmpIiJS : asBC_IncCmpiJS;
+			else if( jump && jump->op == asBC_JNP )
+				curr->op = nextOp == asBC_CMPIi ? asBC_IncCmpIiJNP : asBC_IncCmpiJNP;
+		}
+	}
+}
+
+asCByteInstruction *asCByteCode::GetNextOutputInstr(asCByteInstruction *curr)
+{
+	// Skip the labels, line numbers, and other information
+	// that isn't output as instructions in the final code
+	asCByteInstruction *instr = curr->next;
+	while( instr && instr->GetSize() == 0 )
+		instr = instr->next;
+
+	return instr;
+}
+
 bool asCByteCode::IsTempVarReadByInstr(asCByteInstruction *curr, int offset)
 {
 	// Which instructions read from variables?
@@ -70,6 +70,7 @@ public:
 
 	void Optimize();
 	void OptimizeLocally(const asCArray<int> &tempVariableOffsets);
+	void FuseInstructions();
 	void ExtractLineNumbers();
 	void ExtractObjectVariableInfo(asCScriptFunction *outFunc);
 	void ExtractTryCatchInfo(asCScriptFunction *outFunc);
@@ -160,6 +161,7 @@ protected:
 	bool IsTempVarReadByInstr(asCByteInstruction *curr, int var);
 	bool IsTempVarOverwrittenByInstr(asCByteInstruction *curr, int var);
 	bool IsInstrJmpOrLabel(asCByteInstruction *curr);
+	asCByteInstruction *GetNextOutputInstr(asCByteInstruction *curr);
 
 	int AddInstruction();
 	int AddInstructionFirst();
@@ -201,6 +201,9 @@ asCContext::asCContext(asCScriptEngine *engine, bool holdRef)
 	m_regs.ctx                  = this;
 	m_regs.objectRegister       = 0;
 	m_regs.objectType           = 0;
+	m_interfaceCallCacheHits    = 0;
+	m_interfaceCallCacheMisses  = 0;
+	memset(m_interfaceCallCache, 0, sizeof(m_interfaceCallCache));
 }
 
 asCContext::~asCContext()
@@ -372,6 +375,15 @@ asIScriptFunction *asCContext::GetSystemFunction()
 	return m_callingSystemFunction;
 }
 
+// interface
+void asCContext::GetInterfaceCallCacheStats(asQWORD *hits, asQWORD *misses) const
+{
+	if( hits )
+		*hits = m_interfaceCallCacheHits;
+	if( misses )
+		*misses = m_interfaceCallCacheMisses;
+}
+
 // interface
 int asCContext::PushFunction(asIScriptFunction *func, void *object)
 {
@@ -2133,6 +2145,20 @@ void asCContext::CallInterfaceMethod(asCScriptFunction *func)
 	asCScriptFunction *realFunc = 0;
 	if( func->funcType == asFUNC_INTERFACE )
 	{
+		// Most call sites see the same few object types over and over, so look
+		// in the cache before searching the interfaces of the object type
+		asDWORD generation = m_engine->objectTypeGeneration.get();
+		asPWORD hash = (reinterpret_cast<asPWORD>(func) ^ reinterpret_cast<asPWORD>(objType)) >> 4;
+		SInterfaceCallCacheEntry &entry = m_interfaceCallCache[hash & (INTERFACE_CALL_CACHE_SIZE - 1)];
+		if( entry.interfaceFunc == func && entry.objType == objType && entry.generation == generation )
+		{
+			m_interfaceCallCacheHits++;
+			CallScriptFunction(entry.realFunc);
+			return;
+		}
+
+		m_interfaceCallCacheMisses++;
+
 		// Find the offset for the interface's virtual function table chunk
 		asUINT offset = 0;
 		bool found = false;
@@ -2167,6 +2193,11 @@ void asCContext::CallInterfaceMethod(asCScriptFunction *func)
 		asASSERT( realFunc );
 
 		asASSERT( realFunc->signatureId == func->signatureId );
+
+		entry.interfaceFunc = func;
+		entry.objType       = objType;
+		entry.realFunc      = realFunc;
+		entry.generation    = generation;
 	}
 	else // if( func->funcType == asFUNC_VIRTUAL )
 	{
@@ -2258,13 +2289,13 @@ static const void *const dispatch_table[256] = {
 &&INSTRUCTION(asBC_JLowNZ),		&&INSTRUCTION(asBC_AllocMem),	&&INSTRUCTION(asBC_SetListSize),&&INSTRUCTION(asBC_PshListElmnt),
 &&INSTRUCTION(asBC_SetListType),&&INSTRUCTION(asBC_POWi),		&&INSTRUCTION(asBC_POWu),		&&INSTRUCTION(asBC_POWf),
 &&INSTRUCTION(asBC_POWd),		&&INSTRUCTION(asBC_POWdi),		&&INSTRUCTION(asBC_POWi64),		&&INSTRUCTION(asBC_POWu64),
-&&INSTRUCTION(asBC_Thiscall1),
+&&INSTRUCTION(asBC_Thiscall1),	&&INSTRUCTION(asBC_CmpIiJZ),	&&INSTRUCTION(asBC_CmpIiJNZ),	&&INSTRUCTION(asBC_CmpIiJS),
+&&INSTRUCTION(asBC_CmpIiJNS),	&&INSTRUCTION(asBC_CmpIiJP),	&&INSTRUCTION(asBC_CmpIiJNP),	&&INSTRUCTION(asBC_CmpiJZ),
+&&INSTRUCTION(asBC_CmpiJNZ),	&&INSTRUCTION(asBC_CmpiJS),		&&INSTRUCTION(asBC_CmpiJNS),	&&INSTRUCTION(asBC_CmpiJP),
+&&INSTRUCTION(asBC_CmpiJNP),	&&INSTRUCTION(asBC_PshV4Call),	&&INSTRUCTION(asBC_PshV4V4Call),&&INSTRUCTION(asBC_IncCmpIiJS),
+&&INSTRUCTION(asBC_IncCmpIiJNP),&&INSTRUCTION(asBC_IncCmpiJS),	&&INSTRUCTION(asBC_IncCmpiJNP),
 
-								&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
-&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
-&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
-&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
-&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
+																&&INSTRUCTION(FAULT),
 &&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
 &&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
 &&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),			&&INSTRUCTION(FAULT),
@@ -2387,6 +2418,22 @@ static const void *const dispatch_table[256] = {
 //----------------
 // path control instructions
 
+	// Push the dword values of two variables on the stack, then continue with the
+	// PshV4Call that follows. Keep this right before asBC_PshV4Call
+	INSTRUCTION(asBC_PshV4V4Call):
+		--l_sp;
+		*l_sp = *(l_fp - asBC_SWORDARG0(l_bc));
+		l_bc++;
+		// fall through
+
+	// Push the dword value of a variable on the stack, then continue with
+	// the CALL that follows. Keep this right before asBC_CALL
+	INSTRUCTION(asBC_PshV4Call):
+		--l_sp;
+		*l_sp = *(l_fp - asBC_SWORDARG0(l_bc));
+		l_bc++;
+		// fall through
+
 	// Begin execution of a script function
 	INSTRUCTION(asBC_CALL):
 		{
@@ -4871,27 +4918,229 @@ static const void *const dispatch_table[256] = {
 		}
 		NEXT_INSTRUCTION();
 
+//----------------------------
+// Fused instructions
+//
+// Each of these takes the place of the first instruction of a sequence and
+// executes the whole sequence. The other instructions of the sequence are
+// still in the bytecode, so the position is moved past them, and the jump
+// offsets are relative to the end of the jump instruction as usual.
+
+	// Compare a variable with a constant value, then jump like asBC_JZ
+	INSTRUCTION(asBC_CmpIiJZ):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = asBC_INTARG(l_bc);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 == i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare a variable with a constant value, then jump like asBC_JNZ
+	INSTRUCTION(asBC_CmpIiJNZ):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = asBC_INTARG(l_bc);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 != i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare a variable with a constant value, then jump like asBC_JS
+	INSTRUCTION(asBC_CmpIiJS):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = asBC_INTARG(l_bc);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 < i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare a variable with a constant value, then jump like asBC_JNS
+	INSTRUCTION(asBC_CmpIiJNS):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = asBC_INTARG(l_bc);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 >= i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare a variable with a constant value, then jump like asBC_JP
+	INSTRUCTION(asBC_CmpIiJP):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = asBC_INTARG(l_bc);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 > i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare a variable with a constant value, then jump like asBC_JNP
+	INSTRUCTION(asBC_CmpIiJNP):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = asBC_INTARG(l_bc);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 <= i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare two variables, then jump like asBC_JZ
+	INSTRUCTION(asBC_CmpiJZ):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 == i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare two variables, then jump like asBC_JNZ
+	INSTRUCTION(asBC_CmpiJNZ):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 != i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare two variables, then jump like asBC_JS
+	INSTRUCTION(asBC_CmpiJS):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 < i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare two variables, then jump like asBC_JNS
+	INSTRUCTION(asBC_CmpiJNS):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 >= i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare two variables, then jump like asBC_JP
+	INSTRUCTION(asBC_CmpiJP):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 > i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Compare two variables, then jump like asBC_JNP
+	INSTRUCTION(asBC_CmpiJNP):
+		{
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 <= i2 )
+				l_bc += asBC_INTARG(l_bc+2) + 4;
+			else
+				l_bc += 4;
+		}
+		NEXT_INSTRUCTION();
+
+	// Increment a variable, compare a variable with a constant value, then jump like asBC_JS
+	INSTRUCTION(asBC_IncCmpIiJS):
+		{
+			(*(int*)(l_fp - asBC_SWORDARG0(l_bc)))++;
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc+1));
+			int i2 = asBC_INTARG(l_bc+1);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 < i2 )
+				l_bc += asBC_INTARG(l_bc+3) + 5;
+			else
+				l_bc += 5;
+		}
+		NEXT_INSTRUCTION();
+
+	// Increment a variable, compare a variable with a constant value, then jump like asBC_JNP
+	INSTRUCTION(asBC_IncCmpIiJNP):
+		{
+			(*(int*)(l_fp - asBC_SWORDARG0(l_bc)))++;
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc+1));
+			int i2 = asBC_INTARG(l_bc+1);
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 <= i2 )
+				l_bc += asBC_INTARG(l_bc+3) + 5;
+			else
+				l_bc += 5;
+		}
+		NEXT_INSTRUCTION();
+
+	// Increment a variable, compare two variables, then jump like asBC_JS
+	INSTRUCTION(asBC_IncCmpiJS):
+		{
+			(*(int*)(l_fp - asBC_SWORDARG0(l_bc)))++;
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc+1));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc+1));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 < i2 )
+				l_bc += asBC_INTARG(l_bc+3) + 5;
+			else
+				l_bc += 5;
+		}
+		NEXT_INSTRUCTION();
+
+	// Increment a variable, compare two variables, then jump like asBC_JNP
+	INSTRUCTION(asBC_IncCmpiJNP):
+		{
+			(*(int*)(l_fp - asBC_SWORDARG0(l_bc)))++;
+			int i1 = *(int*)(l_fp - asBC_SWORDARG0(l_bc+1));
+			int i2 = *(int*)(l_fp - asBC_SWORDARG1(l_bc+1));
+			*(int*)&m_regs.valueRegister = (i1 > i2) - (i1 < i2);
+			if( i1 <= i2 )
+				l_bc += asBC_INTARG(l_bc+3) + 5;
+			else
+				l_bc += 5;
+		}
+		NEXT_INSTRUCTION();
+
 	// Don't let the optimizer optimize for size,
 	// since it requires extra conditions and jumps
 #if asUSE_COMPUTED_GOTOS == 0
-	INSTRUCTION(201): l_bc = (asDWORD*)201; goto case_FAULT;
-	INSTRUCTION(202): l_bc = (asDWORD*)202; goto case_FAULT;
-	INSTRUCTION(203): l_bc = (asDWORD*)203; goto case_FAULT;
-	INSTRUCTION(204): l_bc = (asDWORD*)204; goto case_FAULT;
-	INSTRUCTION(205): l_bc = (asDWORD*)205; goto case_FAULT;
-	INSTRUCTION(206): l_bc = (asDWORD*)206; goto case_FAULT;
-	INSTRUCTION(207): l_bc = (asDWORD*)207; goto case_FAULT;
-	INSTRUCTION(208): l_bc = (asDWORD*)208; goto case_FAULT;
-	INSTRUCTION(209): l_bc = (asDWORD*)209; goto case_FAULT;
-	INSTRUCTION(210): l_bc = (asDWORD*)210; goto case_FAULT;
-	INSTRUCTION(211): l_bc = (asDWORD*)211; goto case_FAULT;
-	INSTRUCTION(212): l_bc = (asDWORD*)212; goto case_FAULT;
-	INSTRUCTION(213): l_bc = (asDWORD*)213; goto case_FAULT;
-	INSTRUCTION(214): l_bc = (asDWORD*)214; goto case_FAULT;
-	INSTRUCTION(215): l_bc = (asDWORD*)215; goto case_FAULT;
-	INSTRUCTION(216): l_bc = (asDWORD*)216; goto case_FAULT;
-	INSTRUCTION(217): l_bc = (asDWORD*)217; goto case_FAULT;
-	INSTRUCTION(218): l_bc = (asDWORD*)218; goto case_FAULT;
 	INSTRUCTION(219): l_bc = (asDWORD*)219; goto case_FAULT;
 	INSTRUCTION(220): l_bc = (asDWORD*)220; goto case_FAULT;
 	INSTRUCTION(221): l_bc = (asDWORD*)221; goto case_FAULT;
@@ -4950,7 +5199,7 @@ static const void *const dispatch_table[256] = {
 		asDWORD instr = *(asBYTE*)old;
 		if( instr != asBC_JMP && instr != asBC_JMPP && (instr < asBC_JZ || instr > asBC_JNP) && instr != asBC_JLowZ && instr != asBC_JLowNZ &&
 			instr != asBC_CALL && instr != asBC_CALLBND && instr != asBC_CALLINTF && instr != asBC_RET && instr != asBC_ALLOC && instr != asBC_CallPtr &&
-			instr != asBC_JitEntry )
+			instr != asBC_JitEntry && (instr < asBC_CmpIiJZ || instr > asBC_IncCmpiJNP) )
 		{
 			asASSERT( (l_bc - old) == asBCTypeSize[asBCInfo[instr].type] );
 		}
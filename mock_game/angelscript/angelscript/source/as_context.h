@@ -51,6 +51,9 @@ BEGIN_AS_NAMESPACE
 class asCScriptFunction;
 class asCScriptEngine;
 
+// Number of entries in the interface call cache of each context, a power of 2
+const asUINT INTERFACE_CALL_CACHE_SIZE = 64;
+
 class asCContext : public asIScriptContext
 {
 public:
@@ -143,6 +146,9 @@ public:
 	int GetArgsOnStackCount(asUINT stackLevel);
 	int GetArgOnStack(asUINT stackLevel, asUINT arg, int* typeId, asUINT *flags, void** address);
 
+	// Statistics
+	void GetInterfaceCallCacheStats(asQWORD *hits, asQWORD *misses) const;
+
 public:
 	// Internal public functions
 	asCContext(asCScriptEngine *engine, bool holdRef);
@@ -240,6 +246,21 @@ public:
 
 	asCArray<asPWORD> m_userData;
 
+	// Inline cache for interface method calls. An entry remembers the method
+	// that implements an interface method for an object type. It is only valid
+	// while the engine's objectTypeGeneration is unchanged, as the memory of
+	// destroyed types may be reused.
+	struct SInterfaceCallCacheEntry
+	{
+		asCScriptFunction *interfaceFunc;
+		asCObjectType     *objType;
+		asCScriptFunction *realFunc;
+		asDWORD            generation;
+	};
+	SInterfaceCallCacheEntry m_interfaceCallCache[INTERFACE_CALL_CACHE_SIZE];
+	asQWORD                  m_interfaceCallCacheHits;
+	asQWORD                  m_interfaceCallCacheMisses;
+
 	// Registers available to JIT compiler functions
 	asSVMRegisters m_regs;
 };
@@ -89,6 +89,8 @@ void asCObjectType::DestroyInternal()
 {
 	if( engine == 0 ) return;
 
+	engine->objectTypeGeneration.atomicInc();
+
 	// Skip this for list patterns as they do not increase the references
 	if( flags & asOBJ_LIST_PATTERN )
 	{
@@ -5016,6 +5016,39 @@ void asCWriter::WriteByteCode(asCScriptFunction *func)
 		// Copy the instruction to a temp buffer so we can work on it before saving
 		memcpy(tmpBC, bc, asBCTypeSize[asBCInfo[c].type]*sizeof(asDWORD));
 
+		// Fused instructions are saved as the first instruction of their sequence. The
+		// rest of the sequence is still in the bytecode, so nothing else has to change
+		switch( c )
+		{
+		case asBC_CmpIiJZ:
+		case asBC_CmpIiJNZ:
+		case asBC_CmpIiJS:
+		case asBC_CmpIiJNS:
+		case asBC_CmpIiJP:
+		case asBC_CmpIiJNP:
+			c = asBC_CMPIi;
+			break;
+		case asBC_CmpiJZ:
+		case asBC_CmpiJNZ:
+		case asBC_CmpiJS:
+		case asBC_CmpiJNS:
+		case asBC_CmpiJP:
+		case asBC_CmpiJNP:
+			c = asBC_CMPi;
+			break;
+		case asBC_PshV4Call:
+		case asBC_PshV4V4Call:
+			c = asBC_PshV4;
+			break;
+		case asBC_IncCmpIiJS:
+		case asBC_IncCmpIiJNP:
+		case asBC_IncCmpiJS:
+		case asBC_IncCmpiJNP:
+			c = asBC_IncVi;
+			break;
+		}
+		*(asBYTE*)tmpBC = (asBYTE)c;
+
 		if( c == asBC_ALLOC ) // PTR_DW_ARG
 		{
 			// Translate the object type
@@ -478,6 +478,10 @@ int asCScriptEngine::SetEngineProperty(asEEngineProp property, asPWORD value)
 		ep.alwaysImplDefaultCopyConstruct = (int)value;
 		break;
 
+	case asEP_FUSE_BYTECODE:
+		ep.fuseByteCode = value ? true : false;
+		break;
+
 	default:
 		return asINVALID_ARG;
 	}
@@ -601,6 +605,9 @@ asPWORD asCScriptEngine::GetEngineProperty(asEEngineProp property) const
 	case asEP_ALWAYS_IMPL_DEFAULT_COPY_CONSTRUCT:
 		return ep.alwaysImplDefaultCopyConstruct;
 
+	case asEP_FUSE_BYTECODE:
+		return ep.fuseByteCode;
+
 	default:
 		return 0;
 	}
@@ -676,6 +683,7 @@ asCScriptEngine::asCScriptEngine()
 		ep.jitInterfaceVersion           = 1;         // 1 = JIT compiler uses asJITCompiler, 2 = JIT compiler uses asJITCompilerV2
 		ep.alwaysImplDefaultCopy         = 0;         // 0 = as per language spec, 1 = always implement it, 2, never implement
 		ep.alwaysImplDefaultCopyConstruct = 0;        // 0 = as per language spec, 1 = always implement it, 2, never implement
+		ep.fuseByteCode                  = false;
 	}
 
 	gc.engine = this;
@@ -375,6 +375,9 @@ public:
 
 	// Synchronized
 	mutable asCAtomic      refCount;
+	// Increased whenever an object type is destroyed, to invalidate the caches
+	// that hold object type pointers, e.g. the interface call cache of contexts
+	asCAtomic              objectTypeGeneration;
 	// Synchronized with engineRWLock
 	// This array holds all live script modules
 	asCArray<asCModule *>  scriptModules;
@@ -511,6 +514,7 @@ public:
 		asUINT jitInterfaceVersion;
 		asUINT alwaysImplDefaultCopy;
 		asUINT alwaysImplDefaultCopyConstruct;
+		bool   fuseByteCode;
 	} ep;
 
 	// Callbacks
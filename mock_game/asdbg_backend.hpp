@@ -1,13 +1,25 @@
 #ifndef ASDBG_BACKEND_H
 #define ASDBG_BACKEND_H
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #ifdef _WIN32
@@ -16,10 +28,23 @@
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include <angelscript.h>
+
 namespace asdbg {
 namespace simple_socket {
 
@@ -36,6 +61,17 @@ inline void cleanup() {
 #endif
 }
 
+inline int close_socket(int sock) {
+    // Wake up a receiver thread blocked on the socket
+#ifdef _WIN32
+    shutdown(sock, SD_BOTH);
+    return closesocket(sock);
+#else
+    shutdown(sock, SHUT_RDWR);
+    return close(sock);
+#endif
+}
+
 inline int create_socket(const std::string &ip, int port) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     sockaddr_in server{};
@@ -43,22 +79,52 @@ inline int create_socket(const std::string &ip, int port) {
     server.sin_port = htons(port);
     inet_pton(AF_INET, ip.c_str(), &server.sin_addr);
     if (connect(sock, (sockaddr *)&server, sizeof(server)) < 0) {
+        close_socket(sock);
         return -1;
     }
 
     return sock;
 }
 
-inline int close_socket(int sock) {
+#ifndef _WIN32
+inline int create_unix_socket(const std::string &path) {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un server{};
+    server.sun_family = AF_UNIX;
+    std::strncpy(server.sun_path, path.c_str(), sizeof(server.sun_path) - 1);
+    if (connect(sock, (sockaddr *)&server, sizeof(server)) < 0) {
+        close_socket(sock);
+        return -1;
+    }
+
+    return sock;
+}
+#endif
+
+/// @brief Disable Nagle, so that small messages like "STOP" are not held
+/// back waiting for the ACK of the previous one
+inline void set_no_delay(int sock) {
+    int flag = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
+               reinterpret_cast<const char *>(&flag), sizeof(flag));
+}
+
+inline bool wait_readable(int sock, int timeout_ms) {
 #ifdef _WIN32
-    return closesocket(sock);
+    WSAPOLLFD fd{static_cast<SOCKET>(sock), POLLRDNORM, 0};
+    return WSAPoll(&fd, 1, timeout_ms) > 0;
 #else
-    return close(sock);
+    pollfd fd{sock, POLLIN, 0};
+    return poll(&fd, 1, timeout_ms) > 0;
 #endif
 }
 
 inline int send_data(int sock, const char *data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    return send(sock, data, size, MSG_NOSIGNAL);
+#else
     return send(sock, data, size, 0);
+#endif
 }
 
 inline int receive_data(int sock, char *buffer, size_t buffer_size) {
@@ -69,6 +135,418 @@ inline int receive_data(int sock, char *buffer, size_t buffer_size) {
 
 // -----------------------------------------------
 
+namespace transport {
+
+/// @brief Reliable, in-order byte stream between the backend and the
+/// adapter. The message layer only sees Send/Receive, so it does not care
+/// whether the bytes travel over TCP, a Unix-domain socket or shared memory.
+class ITransport {
+  public:
+    virtual ~ITransport() = default;
+
+    /// @return Number of bytes sent, or a negative value on error
+    virtual int Send(const char *data, size_t size) = 0;
+
+    /// @brief Block until some data is available
+    /// @return Number of bytes received, 0 or negative when disconnected
+    virtual int Receive(char *buffer, size_t bufferSize) = 0;
+
+    /// @return true if Receive would not block, false on timeout
+    virtual bool WaitReadable(int timeoutMs) = 0;
+
+    /// @brief Close the channel and wake up a blocked Receive
+    virtual void Close() = 0;
+};
+
+enum class TransportKind : std::uint8_t {
+    Tcp,
+    UnixSocket,
+    SharedMemory,
+};
+
+struct TransportOptions {
+    TransportKind kind{TransportKind::Tcp};
+    /// IP address for Tcp, socket path for UnixSocket and SharedMemory
+    std::string address{"127.0.0.1"};
+    int port{4712};
+};
+
+/// @brief Stream socket transport, used for both TCP and AF_UNIX
+class SocketTransport : public ITransport {
+  public:
+    explicit SocketTransport(int sock) : m_socket(sock) {}
+
+    ~SocketTransport() override { Close(); }
+
+    int Send(const char *data, size_t size) override {
+        size_t sent = 0;
+        while (sent < size) {
+            const int len =
+                simple_socket::send_data(m_socket, data + sent, size - sent);
+            if (len <= 0)
+                return -1;
+
+            sent += len;
+        }
+
+        return static_cast<int>(sent);
+    }
+
+    int Receive(char *buffer, size_t bufferSize) override {
+        return simple_socket::receive_data(m_socket, buffer, bufferSize);
+    }
+
+    bool WaitReadable(int timeoutMs) override {
+        return simple_socket::wait_readable(m_socket, timeoutMs);
+    }
+
+    void Close() override {
+        if (m_socket >= 0) {
+            simple_socket::close_socket(m_socket);
+            m_socket = -1;
+        }
+    }
+
+  private:
+    int m_socket;
+};
+
+#ifdef __linux__
+
+/// @brief Single-producer single-consumer byte ring living in shared memory
+struct SharedRing {
+    static constexpr std::uint32_t Capacity = 1u << 20;
+
+    /// Written by the producer only
+    alignas(64) std::atomic<std::uint32_t> head;
+    /// Written by the consumer only
+    alignas(64) std::atomic<std::uint32_t> tail;
+    alignas(64) char data[Capacity];
+};
+
+struct SharedRegion {
+    SharedRing toAdapter;
+    SharedRing toEngine;
+};
+
+/// @brief Shared-memory transport for same-host debugging. A pair of SPSC
+/// rings carries the data and eventfds wake up the peer, so bulk transfers
+/// skip the socket stack entirely.
+///
+/// The backend creates the memfd and eventfds and hands them to the adapter
+/// over an AF_UNIX socket (SCM_RIGHTS). That socket stays open afterwards and
+/// only serves to detect that the peer went away.
+class SharedMemoryTransport : public ITransport {
+  public:
+    /// Eventfd order in the SCM_RIGHTS message, after the memfd
+    enum WakeEvent {
+        ToAdapterData,
+        ToAdapterSpace,
+        ToEngineData,
+        ToEngineSpace,
+        WakeEventCount,
+    };
+
+    /// @brief Engine side: set up the shared region and send it to the
+    /// adapter listening on the socket path
+    static std::unique_ptr<ITransport> Connect(const std::string &path) {
+        const int control = simple_socket::create_unix_socket(path);
+        if (control < 0)
+            return nullptr;
+
+        int fds[1 + WakeEventCount];
+        fds[0] = memfd_create("asdbg", MFD_CLOEXEC);
+        if (fds[0] < 0 || ftruncate(fds[0], sizeof(SharedRegion)) < 0) {
+            simple_socket::close_socket(control);
+            return nullptr;
+        }
+
+        for (int i = 0; i < WakeEventCount; ++i) {
+            fds[1 + i] = eventfd(0, EFD_CLOEXEC);
+        }
+
+        char tag[] = "SHM\n";
+        iovec iov{tag, sizeof(tag) - 1};
+        alignas(cmsghdr) char controlBuffer[CMSG_SPACE(sizeof(fds))]{};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = controlBuffer;
+        message.msg_controllen = sizeof(controlBuffer);
+
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        std::unique_ptr<ITransport> transport{};
+        if (sendmsg(control, &message, MSG_NOSIGNAL) >= 0) {
+            transport = Map(control, fds, true);
+        } else {
+            simple_socket::close_socket(control);
+        }
+
+        for (const int fd : fds) {
+            close(fd);
+        }
+
+        return transport;
+    }
+
+    /// @brief Adapter side: receive the shared region from an accepted
+    /// AF_UNIX connection
+    static std::unique_ptr<ITransport> Accept(int control) {
+        int fds[1 + WakeEventCount];
+        char tag[4];
+        iovec iov{tag, sizeof(tag)};
+        alignas(cmsghdr) char controlBuffer[CMSG_SPACE(sizeof(fds))]{};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = controlBuffer;
+        message.msg_controllen = sizeof(controlBuffer);
+
+        const cmsghdr *cmsg = nullptr;
+        if (recvmsg(control, &message, MSG_WAITALL) == sizeof(tag))
+            cmsg = CMSG_FIRSTHDR(&message);
+
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+            cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+            simple_socket::close_socket(control);
+            return nullptr;
+        }
+
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        auto transport = Map(control, fds, false);
+        for (const int fd : fds) {
+            close(fd);
+        }
+
+        return transport;
+    }
+
+    ~SharedMemoryTransport() override {
+        Close();
+        munmap(m_region, sizeof(SharedRegion));
+        for (const int fd : m_events) {
+            close(fd);
+        }
+    }
+
+    int Send(const char *data, size_t size) override {
+        size_t written = 0;
+        while (written < size) {
+            const auto head = m_out->head.load(std::memory_order_relaxed);
+            const auto tail = m_out->tail.load(std::memory_order_acquire);
+            const size_t space = SharedRing::Capacity - (head - tail);
+            if (space == 0) {
+                if (!Wait(m_outSpace, -1))
+                    return -1;
+
+                continue;
+            }
+
+            const auto chunk = std::min(space, size - written);
+            const auto index = head & (SharedRing::Capacity - 1);
+            const auto first =
+                std::min<size_t>(chunk, SharedRing::Capacity - index);
+            std::memcpy(m_out->data + index, data + written, first);
+            std::memcpy(m_out->data, data + written + first, chunk - first);
+
+            m_out->head.store(head + static_cast<std::uint32_t>(chunk),
+                              std::memory_order_release);
+            Signal(m_outData);
+            written += chunk;
+        }
+
+        return static_cast<int>(written);
+    }
+
+    int Receive(char *buffer, size_t bufferSize) override {
+        while (true) {
+            const auto tail = m_in->tail.load(std::memory_order_relaxed);
+            const auto head = m_in->head.load(std::memory_order_acquire);
+            const size_t available = head - tail;
+            if (available == 0) {
+                if (!Wait(m_inData, -1))
+                    return 0;
+
+                continue;
+            }
+
+            const auto chunk = std::min(available, bufferSize);
+            const auto index = tail & (SharedRing::Capacity - 1);
+            const auto first =
+                std::min<size_t>(chunk, SharedRing::Capacity - index);
+            std::memcpy(buffer, m_in->data + index, first);
+            std::memcpy(buffer + first, m_in->data, chunk - first);
+
+            m_in->tail.store(tail + static_cast<std::uint32_t>(chunk),
+                             std::memory_order_release);
+
+            // The producer only waits for space after seeing a full ring
+            if (available == SharedRing::Capacity)
+                Signal(m_inSpace);
+
+            return static_cast<int>(chunk);
+        }
+    }
+
+    bool WaitReadable(int timeoutMs) override {
+        while (m_in->head.load(std::memory_order_acquire) ==
+               m_in->tail.load(std::memory_order_relaxed)) {
+            if (!Wait(m_inData, timeoutMs))
+                return false;
+        }
+
+        return true;
+    }
+
+    void Close() override {
+        if (m_control >= 0) {
+            simple_socket::close_socket(m_control);
+            m_control = -1;
+        }
+    }
+
+  private:
+    SharedRegion *m_region;
+    int m_control;
+    int m_events[WakeEventCount];
+    SharedRing *m_out;
+    SharedRing *m_in;
+    int m_outData, m_outSpace, m_inData, m_inSpace;
+
+    SharedMemoryTransport(SharedRegion *region, int control, const int *events,
+                          bool isEngine)
+        : m_region(region), m_control(control) {
+        for (int i = 0; i < WakeEventCount; ++i) {
+            m_events[i] = dup(events[i]);
+        }
+
+        if (isEngine) {
+            m_out = &region->toAdapter;
+            m_in = &region->toEngine;
+            m_outData = m_events[ToAdapterData];
+            m_outSpace = m_events[ToAdapterSpace];
+            m_inData = m_events[ToEngineData];
+            m_inSpace = m_events[ToEngineSpace];
+        } else {
+            m_out = &region->toEngine;
+            m_in = &region->toAdapter;
+            m_outData = m_events[ToEngineData];
+            m_outSpace = m_events[ToEngineSpace];
+            m_inData = m_events[ToAdapterData];
+            m_inSpace = m_events[ToAdapterSpace];
+        }
+    }
+
+    static std::unique_ptr<ITransport> Map(int control, const int *fds,
+                                           bool isEngine) {
+        void *region = mmap(nullptr, sizeof(SharedRegion),
+                            PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (region == MAP_FAILED) {
+            simple_socket::close_socket(control);
+            return nullptr;
+        }
+
+        return std::unique_ptr<ITransport>(new SharedMemoryTransport(
+            static_cast<SharedRegion *>(region), control, fds + 1, isEngine));
+    }
+
+    static void Signal(int event) {
+        const std::uint64_t one = 1;
+        (void)!write(event, &one, sizeof(one));
+    }
+
+    /// @return false on timeout, or when the peer or Close() shut the
+    /// control socket
+    bool Wait(int event, int timeoutMs) {
+        const int control = m_control;
+        if (control < 0)
+            return false;
+
+        pollfd fds[2] = {{event, POLLIN, 0}, {control, POLLIN, 0}};
+        if (poll(fds, 2, timeoutMs) <= 0 || fds[1].revents != 0)
+            return false;
+
+        std::uint64_t count;
+        (void)!read(event, &count, sizeof(count));
+        return true;
+    }
+};
+
+#endif // __linux__
+
+/// @return Connected transport, or nullptr on failure
+inline std::unique_ptr<ITransport> Connect(const TransportOptions &options) {
+    int sock = -1;
+    switch (options.kind) {
+    case TransportKind::Tcp:
+        sock = simple_socket::create_socket(options.address, options.port);
+        if (sock >= 0)
+            simple_socket::set_no_delay(sock);
+        break;
+#ifndef _WIN32
+    case TransportKind::UnixSocket:
+        sock = simple_socket::create_unix_socket(options.address);
+        break;
+#endif
+#ifdef __linux__
+    case TransportKind::SharedMemory:
+        return SharedMemoryTransport::Connect(options.address);
+#endif
+    default:
+        std::cerr << "Transport not supported on this platform.\n";
+        return nullptr;
+    }
+
+    if (sock < 0)
+        return nullptr;
+
+    return std::unique_ptr<ITransport>(new SocketTransport(sock));
+}
+
+/// @brief Parse "tcp:<ip>:<port>", "unix:<path>" or "shm:<path>", e.g. from
+/// an environment variable
+/// @return false if the spec is malformed
+inline bool ParseTransportOptions(const std::string &spec,
+                                  TransportOptions &options) {
+    const auto colon = spec.find(':');
+    const auto scheme = spec.substr(0, colon);
+    const auto rest = colon == std::string::npos ? "" : spec.substr(colon + 1);
+
+    if (scheme == "tcp") {
+        options.kind = TransportKind::Tcp;
+        const auto portColon = rest.rfind(':');
+        if (portColon == std::string::npos)
+            return false;
+
+        options.address = rest.substr(0, portColon);
+        options.port = std::atoi(rest.c_str() + portColon + 1);
+        return options.port > 0;
+    }
+
+    if (rest.empty())
+        return false;
+
+    if (scheme == "unix") {
+        options.kind = TransportKind::UnixSocket;
+    } else if (scheme == "shm") {
+        options.kind = TransportKind::SharedMemory;
+    } else {
+        return false;
+    }
+
+    options.address = rest;
+    return true;
+}
+
+} // namespace transport
+
+// -----------------------------------------------
+
 #if __cplusplus >= 201703L
 
 #define ASDBG_NODISCARD [[nodiscard]]
@@ -202,17 +680,45 @@ bool EndWith(string_view str, string_view suffix) {
                        suffix.size()) == 0;
 }
 
+enum class ParseResult : std::uint8_t {
+    Unmatched,
+    Parsed,
+    /// The message continues in data that has not been received yet
+    Incomplete,
+};
+
 class MessageQueue {
   public:
-    MessageQueue(string_view data) : m_pos(0) { m_lines = SplitLines(data); }
+    MessageQueue(string_view data) : m_data(data), m_pos(0) {
+        m_lines = SplitLines(data);
+    }
 
     bool IsEmpty() const { return m_pos >= m_lines.size(); }
 
-    string_view Peek() const {
+    size_t Remaining() const { return m_lines.size() - m_pos; }
+
+    /// @return Byte offset of the next line in the source data
+    size_t Offset() const {
         if (IsEmpty())
+            return m_data.size();
+
+        return static_cast<size_t>(m_lines[m_pos].data() - m_data.data());
+    }
+
+    bool Contains(string_view line) const {
+        for (size_t i = m_pos; i < m_lines.size(); ++i) {
+            if (m_lines[i] == line)
+                return true;
+        }
+
+        return false;
+    }
+
+    string_view Peek(size_t ahead = 0) const {
+        if (m_pos + ahead >= m_lines.size())
             return {};
 
-        return m_lines[m_pos];
+        return m_lines[m_pos + ahead];
     }
 
     string_view Pop() {
@@ -225,6 +731,7 @@ class MessageQueue {
     }
 
   private:
+    string_view m_data;
     std::vector<string_view> m_lines;
     size_t m_pos;
 };
@@ -263,6 +770,193 @@ bool AreSameFiles(string_view lhs, string_view rhs) {
     return true;
 }
 
+/// @brief Lowercase file name without directories, i.e. what AreSameFiles
+/// compares
+std::string FileNameKey(string_view filepath) {
+    size_t start = 0;
+    for (size_t i = 0; i < filepath.size(); ++i) {
+        if (filepath[i] == '/' || filepath[i] == '\\')
+            start = i + 1;
+    }
+
+    std::string key{};
+    key.reserve(filepath.size() - start);
+    for (size_t i = start; i < filepath.size(); ++i) {
+        key += static_cast<char>(
+            std::tolower(static_cast<unsigned char>(filepath[i])));
+    }
+
+    return key;
+}
+
+/// @return false unless the whole string is a non-negative decimal number
+bool ParseInt(string_view str, int &value) {
+    if (str.empty())
+        return false;
+
+    value = 0;
+    for (const char c : str) {
+        if (c < '0' || c > '9')
+            return false;
+
+        value = value * 10 + (c - '0');
+    }
+
+    return true;
+}
+
+/// @brief 64-bit FNV-1a
+/// @param hash Hash of the preceding bytes, to hash data in several pieces
+std::uint64_t HashBytes(const char *data, size_t size,
+                        std::uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+template <typename... Args>
+void AppendFormat(std::string &out, const char *format, Args... args) {
+    char buffer[64];
+    const int len = std::snprintf(buffer, sizeof(buffer), format, args...);
+    if (len > 0)
+        out.append(buffer, std::min(static_cast<size_t>(len), sizeof(buffer)));
+}
+
+/// @brief Append a value as a single protocol line, with line breaks escaped
+void AppendEscaped(std::string &out, string_view str) {
+    for (const char c : str) {
+        if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else {
+            out += c;
+        }
+    }
+}
+
+/// @brief Appends the display value of an object of a host type
+using ValueFormatter = void (*)(std::string &out, const void *value);
+
+/// @brief ValueFormatter instantiated by AsdbgBackend::RegisterFormatter
+template <typename T, void (*Format)(std::string &, const T &)>
+void FormatValue(std::string &out, const void *value) {
+    Format(out, *static_cast<const T *>(value));
+}
+
+/// @brief Append the value of a script variable for display
+/// @param formatters Formatters of host types, indexed by the sequence
+/// number of the type id
+void AppendValue(std::string &out, asIScriptEngine *engine, const void *value,
+                 int typeId,
+                 const std::vector<ValueFormatter> *formatters = nullptr) {
+    if (!value) {
+        out += "null";
+        return;
+    }
+
+    switch (typeId) {
+    case asTYPEID_VOID:
+        out += "void";
+        return;
+    case asTYPEID_BOOL:
+        out += *static_cast<const bool *>(value) ? "true" : "false";
+        return;
+    case asTYPEID_INT8:
+        AppendFormat(out, "%d", *static_cast<const std::int8_t *>(value));
+        return;
+    case asTYPEID_INT16:
+        AppendFormat(out, "%d", *static_cast<const std::int16_t *>(value));
+        return;
+    case asTYPEID_INT32:
+        AppendFormat(out, "%d", *static_cast<const std::int32_t *>(value));
+        return;
+    case asTYPEID_INT64:
+        AppendFormat(out, "%lld",
+                     static_cast<long long>(
+                         *static_cast<const std::int64_t *>(value)));
+        return;
+    case asTYPEID_UINT8:
+        AppendFormat(out, "%u", *static_cast<const std::uint8_t *>(value));
+        return;
+    case asTYPEID_UINT16:
+        AppendFormat(out, "%u", *static_cast<const std::uint16_t *>(value));
+        return;
+    case asTYPEID_UINT32:
+        AppendFormat(out, "%u", *static_cast<const std::uint32_t *>(value));
+        return;
+    case asTYPEID_UINT64:
+        AppendFormat(out, "%llu",
+                     static_cast<unsigned long long>(
+                         *static_cast<const std::uint64_t *>(value)));
+        return;
+    case asTYPEID_FLOAT:
+        AppendFormat(out, "%g", *static_cast<const float *>(value));
+        return;
+    case asTYPEID_DOUBLE:
+        AppendFormat(out, "%g", *static_cast<const double *>(value));
+        return;
+    default:
+        break;
+    }
+
+    asITypeInfo *type = engine->GetTypeInfoById(typeId);
+    if (!type) {
+        out += "?";
+        return;
+    }
+
+    if ((typeId & asTYPEID_MASK_OBJECT) == 0) {
+        // Enum: show the name of the value when there is one
+        const int enumValue = *static_cast<const int *>(value);
+        for (asUINT i = 0; i < type->GetEnumValueCount(); ++i) {
+            int candidate;
+            const char *name = type->GetEnumValueByIndex(i, &candidate);
+            if (candidate == enumValue) {
+                out += name;
+                return;
+            }
+        }
+
+        AppendFormat(out, "%d", enumValue);
+        return;
+    }
+
+    if (typeId & asTYPEID_OBJHANDLE) {
+        value = *static_cast<void *const *>(value);
+        if (!value) {
+            out += "null";
+            return;
+        }
+    }
+
+    const auto formatterIndex =
+        static_cast<size_t>(typeId & asTYPEID_MASK_SEQNBR);
+    if (formatters && formatterIndex < formatters->size() &&
+        (*formatters)[formatterIndex]) {
+        (*formatters)[formatterIndex](out, value);
+        return;
+    }
+
+    // The string type of scriptstdstring, which is what the string literals
+    // of the script are made of
+    if ((typeId & ~asTYPEID_OBJHANDLE & ~asTYPEID_HANDLETOCONST) ==
+            engine->GetStringFactoryReturnTypeId() &&
+        type->GetSize() == sizeof(std::string)) {
+        const auto &str = *static_cast<const std::string *>(value);
+        out += '"';
+        AppendEscaped(out, string_view(str.data(), str.size()));
+        out += '"';
+        return;
+    }
+
+    out += type->GetName();
+    AppendFormat(out, "{%p}", value);
+}
+
 } // namespace detail
 
 // -----------------------------------------------
@@ -278,161 +972,2358 @@ enum class DebugCommand : std::uint8_t {
     StepIn,
     Continue,
 };
-class AsdbgBackend {
-  public:
-    AsdbgBackend() = default;
-
-    void Start(std::atomic<bool> &running) {
-        simple_socket::init();
 
-        m_socket = simple_socket::create_socket("127.0.0.1", 4712);
-        if (m_socket < 0) {
-            std::cerr << "Failed to connect to debugger.\n";
-            throw std::runtime_error("Failed to connect to debugger.");
-        }
+/// @brief Which script exceptions stop in the debugger
+enum class ExceptionBreakMode : std::uint8_t {
+    Never,
+    Uncaught,
+    All,
+};
 
-        StartReceiverThread(running);
+/// @brief Exponential backoff between connection attempts
+struct ReconnectPolicy {
+    int initialDelayMs{100};
+    int maxDelayMs{5000};
+};
 
-        SendBreakpointsRequest();
-    }
+// -----------------------------------------------
 
-    void Shutdown() {
-        if (m_socket >= 0) {
-            simple_socket::close_socket(m_socket);
-            simple_socket::cleanup();
-        }
+/// @brief Census of the objects known to the garbage collector, taken a
+/// bounded number of objects at a time so that a large heap does not stall
+/// the script. Objects may be collected or promoted to the old generation
+/// between slices, so the result is approximate.
+///
+/// Must be stepped on a thread that runs scripts of the engine, as it reads
+/// the objects.
+class GcCensus {
+  public:
+    struct TypeEntry {
+        asITypeInfo *type{};
+        size_t count{};
+        size_t bytes{};
+        size_t newCount{};
+        size_t oldCount{};
+    };
+
+    struct ArrayEntry {
+        asITypeInfo *type{};
+        asUINT length{};
+        size_t bytes{};
+    };
+
+    static constexpr size_t LargestArrayCount = 10;
+
+    void Begin(asIScriptEngine *engine) {
+        m_engine = engine;
+        m_next = 0;
+        m_types.clear();
+        m_largestArrays.clear();
     }
 
-    /// @return Breakpoint if found, otherwise nullptr
     ASDBG_NODISCARD
-    const Breakpoint *FindBreakpoint(const std::string &filepath, int line) {
-        std::lock_guard<std::mutex> lock{m_breankpointMutex};
+    bool IsStarted() const { return m_engine != nullptr; }
 
-        for (const auto &bp : m_breankpointList) {
-            if (bp.line == line &&
-                detail::AreSameFiles(bp.filepath,
-                                     filepath) // TODO: Compare absolute path
-            ) {
-                return &bp;
+    ASDBG_NODISCARD
+    asIScriptEngine *GetEngine() const { return m_engine; }
+
+    /// @return true when every object has been visited
+    bool Step(asUINT maxObjects) {
+        asUINT total{}, newObjects{};
+        m_engine->GetGCStatistics(&total, nullptr, nullptr, &newObjects);
+
+        const asUINT end = std::min(total, m_next + maxObjects);
+        for (; m_next < end; ++m_next) {
+            void *obj{};
+            asITypeInfo *type{};
+            if (m_engine->GetObjectInGC(m_next, nullptr, &obj, &type) < 0)
+                return true; // Collected since the statistics were read
+
+            if (!obj || !type)
+                continue;
+
+            auto &entry = m_types[type];
+            entry.type = type;
+            entry.count++;
+            if (m_next < newObjects) {
+                entry.newCount++;
+            } else {
+                entry.oldCount++;
             }
+
+            entry.bytes += ApproximateSize(obj, type);
         }
 
-        return nullptr;
+        return m_next >= total;
     }
 
     ASDBG_NODISCARD
-    std::string GetAbsolutePath(const std::string &filename) { // FIXME!
-        // TODO
-        for (const auto &bp : m_breankpointList) {
-            if (detail::EndWith(bp.filepath, filename)) {
-                return bp.filepath;
-            }
+    asUINT Visited() const { return m_next; }
+
+    /// @brief Sorted by approximate bytes, largest first
+    ASDBG_NODISCARD
+    std::vector<TypeEntry> Types() const {
+        std::vector<TypeEntry> types{};
+        types.reserve(m_types.size());
+        for (const auto &entry : m_types) {
+            types.push_back(entry.second);
         }
 
-        return filename;
+        std::sort(types.begin(), types.end(),
+                  [](const TypeEntry &lhs, const TypeEntry &rhs) {
+                      return lhs.bytes > rhs.bytes;
+                  });
+        return types;
     }
 
-    /// @brief Stop at the breakpoint in VSCode and wait for the command from
-    /// the debugger
+    /// @brief Sorted by approximate bytes, largest first
     ASDBG_NODISCARD
-    DebugCommand TriggerBreakpoint(const Breakpoint &bp) {
-        std::string request = "STOP\n";
-        request += bp.filepath + "," + std::to_string(bp.line) + "\n";
-        simple_socket::send_data(m_socket, request.c_str(), request.size());
-
-        SendVariables();
+    const std::vector<ArrayEntry> &LargestArrays() const {
+        return m_largestArrays;
+    }
 
-        // Wait for the command from the debugger
-        DebugCommand cmd{DebugCommand::Nothing};
-        while (true) {
-            cmd = m_debugCommand.load();
-            if (cmd != DebugCommand::Nothing) {
-                m_debugCommand.store(DebugCommand::Nothing);
-                break;
-            }
+    void End() { m_engine = nullptr; }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  private:
+    asIScriptEngine *m_engine{};
+    asUINT m_next{};
+    std::unordered_map<asITypeInfo *, TypeEntry> m_types{};
+    std::vector<ArrayEntry> m_largestArrays{};
+
+    size_t ApproximateSize(void *obj, asITypeInfo *type) {
+#ifdef SCRIPTARRAY_H
+        // Include scriptarray.h before this header to account for the
+        // elements of arrays
+        if (std::strcmp(type->GetName(), "array") == 0 &&
+            (type->GetFlags() & asOBJ_TEMPLATE)) {
+            const auto array = static_cast<const CScriptArray *>(obj);
+            const auto length = array->GetSize();
+            const auto bytes =
+                sizeof(CScriptArray) + length * ElementSize(type);
+            AddArray(ArrayEntry{type, length, bytes});
+            return bytes;
         }
-
+#else
+        (void)obj;
+#endif
+
+        return type->GetSize();
+    }
+
+    size_t ElementSize(asITypeInfo *arrayType) const {
+        const int subTypeId = arrayType->GetSubTypeId();
+        if (subTypeId & asTYPEID_OBJHANDLE)
+            return sizeof(void *);
+
+        if ((subTypeId & asTYPEID_MASK_OBJECT) == 0)
+            return m_engine->GetSizeOfPrimitiveType(subTypeId);
+
+        asITypeInfo *subType = m_engine->GetTypeInfoById(subTypeId);
+        if (subType && (subType->GetFlags() & asOBJ_VALUE))
+            return subType->GetSize();
+
+        return sizeof(void *); // Reference types are stored as pointers
+    }
+
+    void AddArray(const ArrayEntry &entry) {
+        if (m_largestArrays.size() == LargestArrayCount &&
+            m_largestArrays.back().bytes >= entry.bytes)
+            return;
+
+        const auto pos = std::upper_bound(
+            m_largestArrays.begin(), m_largestArrays.end(), entry,
+            [](const ArrayEntry &lhs, const ArrayEntry &rhs) {
+                return lhs.bytes > rhs.bytes;
+            });
+        m_largestArrays.insert(pos, entry);
+        if (m_largestArrays.size() > LargestArrayCount)
+            m_largestArrays.pop_back();
+    }
+};
+
+/// @brief Lines with code per script section, collected from the line
+/// tables of compiled functions. Sections are told apart by file name only,
+/// as breakpoints are matched by AreSameFiles.
+class LineIndex {
+  public:
+    /// @brief Index every script function compiled into the module, which
+    /// includes methods, constructors, lambdas and global initializers
+    void AddModule(asIScriptModule *module) {
+        asIScriptEngine *engine = module->GetEngine();
+        for (int id = 0; id <= engine->GetLastFunctionId(); ++id) {
+            asIScriptFunction *func = engine->GetFunctionById(id);
+            if (func && func->GetModule() == module)
+                AddFunction(func);
+        }
+
+        // Sections are combined in any order, as the map has none
+        m_hash = 0;
+        for (auto &section : m_lines) {
+            auto &lines = section.second;
+            std::sort(lines.begin(), lines.end());
+            lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+            const auto &key = section.first;
+            m_hash ^= detail::HashBytes(
+                reinterpret_cast<const char *>(lines.data()),
+                lines.size() * sizeof(int),
+                detail::HashBytes(key.data(), key.size()));
+        }
+    }
+
+    void Clear() {
+        m_lines.clear();
+        m_hash = 0;
+    }
+
+    /// @brief Hash of the lines with code, which changes only when a rebuilt
+    /// module moves code to other lines
+    ASDBG_NODISCARD
+    std::uint64_t Hash() const { return m_hash; }
+
+    ASDBG_NODISCARD
+    bool HasSection(string_view filepath) const {
+        return m_lines.find(detail::FileNameKey(filepath)) != m_lines.end();
+    }
+
+    /// @return The first line with code at or after the line, or 0 if there
+    /// is none or the section is not indexed
+    ASDBG_NODISCARD
+    int FindLineWithCode(string_view filepath, int line) const {
+        const auto section = m_lines.find(detail::FileNameKey(filepath));
+        if (section == m_lines.end())
+            return 0;
+
+        const auto &lines = section->second;
+        const auto pos = std::lower_bound(lines.begin(), lines.end(), line);
+        return pos == lines.end() ? 0 : *pos;
+    }
+
+    /// @brief Lines with code within [startLine, endLine]
+    ASDBG_NODISCARD
+    std::vector<int> LinesWithCode(string_view filepath, int startLine,
+                                   int endLine) const {
+        const auto section = m_lines.find(detail::FileNameKey(filepath));
+        if (section == m_lines.end())
+            return {};
+
+        const auto &lines = section->second;
+        return std::vector<int>(
+            std::lower_bound(lines.begin(), lines.end(), startLine),
+            std::upper_bound(lines.begin(), lines.end(), endLine));
+    }
+
+  private:
+    std::unordered_map<std::string, std::vector<int>> m_lines{};
+    std::uint64_t m_hash{};
+
+    void AddFunction(asIScriptFunction *func) {
+        if (!func || func->GetFuncType() != asFUNC_SCRIPT)
+            return;
+
+        const char *section{};
+        int declaredAt{};
+        func->GetDeclaredAt(&section, &declaredAt, nullptr);
+        if (!section)
+            return;
+
+        auto &lines = m_lines[detail::FileNameKey(section)];
+
+        // Walk the line table through the public interface. Lines before the
+        // declaration are reported only for constructors, whose member
+        // initializers come first.
+        int line = IsConstructor(func) ? FirstConstructorLine(func, declaredAt)
+                                       : declaredAt;
+        while ((line = func->FindNextLineWithCode(line)) >= 0) {
+            lines.push_back(line);
+            ++line;
+        }
+    }
+
+    static bool IsConstructor(asIScriptFunction *func) {
+        asITypeInfo *type = func->GetObjectType();
+        return type && std::strcmp(type->GetName(), func->GetName()) == 0;
+    }
+
+    /// @brief Constructors report no line before both their declaration and
+    /// their first line entry, so the first entry is found by bisection
+    static int FirstConstructorLine(asIScriptFunction *func, int declaredAt) {
+        int low = 1, high = declaredAt;
+        while (low < high) {
+            const int mid = low + (high - low) / 2;
+            if (func->FindNextLineWithCode(mid) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        return low;
+    }
+};
+
+/// @brief Durations in power-of-two buckets of nanoseconds. Bucket i holds
+/// [2^i, 2^(i+1)) and bucket 0 also holds 0. Lock-free, so any thread may
+/// record.
+class DurationHistogram {
+  public:
+    static constexpr size_t BucketCount = 40;
+
+    struct Summary {
+        std::uint64_t count{};
+        std::uint64_t totalNs{};
+        std::uint64_t maxNs{};
+        /// Upper bounds of the buckets holding the percentiles
+        std::uint64_t p50Ns{};
+        std::uint64_t p99Ns{};
+    };
+
+    void Record(std::chrono::steady_clock::duration duration) {
+        const auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(
+            0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                   .count()));
+
+        size_t bucket = 0;
+        while (bucket + 1 < BucketCount && (ns >> (bucket + 1)) != 0)
+            ++bucket;
+
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+        auto max = m_maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !m_maxNs.compare_exchange_weak(
+                               max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    ASDBG_NODISCARD
+    Summary Summarize() const {
+        std::uint64_t buckets[BucketCount];
+        Summary summary{};
+        for (size_t i = 0; i < BucketCount; ++i) {
+            buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+            summary.count += buckets[i];
+        }
+
+        summary.totalNs = m_totalNs.load(std::memory_order_relaxed);
+        summary.maxNs = m_maxNs.load(std::memory_order_relaxed);
+        summary.p50Ns = Percentile(buckets, summary, 50);
+        summary.p99Ns = Percentile(buckets, summary, 99);
+        return summary;
+    }
+
+  private:
+    std::atomic<std::uint64_t> m_buckets[BucketCount]{};
+    std::atomic<std::uint64_t> m_count{0};
+    std::atomic<std::uint64_t> m_totalNs{0};
+    std::atomic<std::uint64_t> m_maxNs{0};
+
+    static std::uint64_t Percentile(const std::uint64_t *buckets,
+                                    const Summary &summary, int percent) {
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < BucketCount; ++i) {
+            seen += buckets[i];
+            if (seen * 100 >= summary.count * percent && seen > 0) {
+                const std::uint64_t upper = (std::uint64_t{2} << i) - 1;
+                return std::min(upper, summary.maxNs);
+            }
+        }
+
+        return 0;
+    }
+};
+
+/// @brief Overhead of the backend itself, see AsdbgBackend::GetMetrics
+struct BackendMetrics {
+    std::uint64_t lineCallbacks{};
+    std::uint64_t bytesSent{};
+    std::uint64_t bytesReceived{};
+    /// By message type, i.e. the first line of the message
+    std::map<std::string, std::uint64_t> messagesSent{};
+    std::map<std::string, std::uint64_t> messagesReceived{};
+    /// Sampled once per AsdbgBackend::FindBreakpointSampleRate line callbacks
+    DurationHistogram::Summary findBreakpoint{};
+    /// From reporting a stop until the script resumes
+    DurationHistogram::Summary stopToResume{};
+    DurationHistogram::Summary variableSerialization{};
+};
+
+// -----------------------------------------------
+
+enum class SnapshotKind : std::uint32_t {
+    Stop = 1,
+    Exception = 2,
+};
+
+/// @brief Append-only file of binary stop snapshots, written through memory
+/// mapped segments of a fixed size. The file grows a segment at a time, so
+/// appending a record costs a copy into the mapping and no allocation.
+/// Records stay in the page cache when the process crashes.
+///
+/// All values are in host byte order. The first segment starts with the
+/// file header:
+/// ```
+/// char[8] "ASDBGSNP"
+/// u32     format version
+/// u32     segment size
+/// ```
+/// followed by the records. A record never crosses a segment, and a zero
+/// record size ends the records of a segment.
+/// ```
+/// u32     record size, including these 16 bytes
+/// u32     SnapshotKind
+/// u64     time since the epoch in nanoseconds
+/// ...     payload
+/// ```
+///
+/// Not thread-safe.
+class SnapshotWriter {
+  public:
+    static constexpr std::uint32_t FormatVersion = 1;
+    static constexpr size_t FileHeaderSize = 16;
+    static constexpr size_t RecordHeaderSize = 16;
+
+    SnapshotWriter() = default;
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    ~SnapshotWriter() { Close(); }
+
+    /// @brief Continue the file if it has a valid header, otherwise create
+    /// it. The segment size is rounded up to whole pages, and an existing
+    /// file keeps its own.
+    /// @return false if the file cannot be mapped
+    bool Open(const std::string &path, size_t segmentSize) {
+        Close();
+#ifdef _WIN32
+        (void)path;
+        (void)segmentSize;
+        return false; // TODO: CreateFileMapping
+#else
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0)
+            return false;
+
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        m_segmentSize = (std::max(segmentSize, pageSize) + pageSize - 1) /
+                        pageSize * pageSize;
+
+        struct stat st {};
+        fstat(m_fd, &st);
+        const auto fileSize = static_cast<size_t>(st.st_size);
+
+        char header[FileHeaderSize]{};
+        std::uint32_t version{}, existingSegmentSize{};
+        if (fileSize >= FileHeaderSize &&
+            pread(m_fd, header, sizeof(header), 0) ==
+                static_cast<ssize_t>(sizeof(header))) {
+            std::memcpy(&version, header + 8, 4);
+            std::memcpy(&existingSegmentSize, header + 12, 4);
+        }
+
+        if (std::memcmp(header, "ASDBGSNP", 8) == 0 &&
+            version == FormatVersion && existingSegmentSize != 0 &&
+            existingSegmentSize % pageSize == 0 &&
+            fileSize >= existingSegmentSize) {
+            m_segmentSize = existingSegmentSize;
+            if (!MapSegment(fileSize / m_segmentSize - 1)) {
+                Close();
+                return false;
+            }
+
+            SkipRecords();
+            return true;
+        }
+
+        if (ftruncate(m_fd, 0) != 0 || !MapSegment(0)) {
+            Close();
+            return false;
+        }
+
+        const std::uint32_t headerFields[] = {
+            FormatVersion, static_cast<std::uint32_t>(m_segmentSize)};
+        std::memcpy(m_segment, "ASDBGSNP", 8);
+        std::memcpy(m_segment + 8, headerFields, sizeof(headerFields));
+        m_pos = FileHeaderSize;
+        return true;
+#endif
+    }
+
+    void Close() {
+#ifndef _WIN32
+        if (m_segment)
+            munmap(m_segment, m_segmentSize);
+
+        if (m_fd >= 0)
+            close(m_fd);
+#endif
+
+        m_segment = nullptr;
+        m_fd = -1;
+    }
+
+    ASDBG_NODISCARD
+    bool IsOpen() const { return m_segment != nullptr; }
+
+    /// @brief Append a record whose payload `write(*this)` writes. When the
+    /// record does not fit in the current segment, it is written again at
+    /// the start of a new one.
+    /// @return false if the record does not fit in a segment and is dropped
+    template <typename Write> bool Append(SnapshotKind kind, Write &&write) {
+        if (!IsOpen())
+            return false;
+
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            const size_t start = m_pos;
+            m_overflow = false;
+            Skip(RecordHeaderSize);
+            write(*this);
+            if (!m_overflow) {
+                const auto size = static_cast<std::uint32_t>(m_pos - start);
+                const auto kindValue = static_cast<std::uint32_t>(kind);
+                const auto timestamp = static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count());
+                std::memcpy(m_segment + start + 4, &kindValue, 4);
+                std::memcpy(m_segment + start + 8, &timestamp, 8);
+                // The size goes last, so a torn record reads as the end
+                std::memcpy(m_segment + start, &size, 4);
+                return true;
+            }
+
+            m_pos = start;
+            const size_t segmentStart = m_segmentIndex == 0 ? FileHeaderSize
+                                                            : 0;
+            if (start == segmentStart || !MapSegment(m_segmentIndex + 1))
+                break;
+        }
+
+        m_overflow = false;
+        return false;
+    }
+
+    void WriteU8(std::uint8_t value) { WriteBytes(&value, sizeof(value)); }
+
+    void WriteU32(std::uint32_t value) { WriteBytes(&value, sizeof(value)); }
+
+    void WriteI32(std::int32_t value) { WriteBytes(&value, sizeof(value)); }
+
+    void WriteString(string_view str) {
+        WriteU32(static_cast<std::uint32_t>(str.size()));
+        WriteBytes(str.data(), str.size());
+    }
+
+    /// @return Position of a u32 to fill in later with PatchU32
+    size_t ReserveU32() {
+        const size_t pos = m_pos;
+        Skip(sizeof(std::uint32_t));
+        return pos;
+    }
+
+    void PatchU32(size_t pos, std::uint32_t value) {
+        if (!m_overflow)
+            std::memcpy(m_segment + pos, &value, sizeof(value));
+    }
+
+  private:
+    int m_fd{-1};
+    char *m_segment{};
+    size_t m_segmentSize{};
+    size_t m_segmentIndex{};
+    size_t m_pos{};
+    bool m_overflow{};
+
+    void WriteBytes(const void *data, size_t size) {
+        const size_t pos = m_pos;
+        Skip(size);
+        if (!m_overflow)
+            std::memcpy(m_segment + pos, data, size);
+    }
+
+    void Skip(size_t size) {
+        if (m_overflow || size > m_segmentSize - m_pos) {
+            m_overflow = true;
+            return;
+        }
+
+        m_pos += size;
+    }
+
+    /// @brief Map the segment, growing the file to hold it
+    bool MapSegment(size_t index) {
+#ifdef _WIN32
+        (void)index;
+        return false;
+#else
+        const auto end = static_cast<off_t>((index + 1) * m_segmentSize);
+        struct stat st {};
+        if (fstat(m_fd, &st) != 0 ||
+            (st.st_size < end && ftruncate(m_fd, end) != 0))
+            return false;
+
+        void *segment = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, m_fd,
+                             static_cast<off_t>(index * m_segmentSize));
+        if (segment == MAP_FAILED)
+            return false;
+
+        if (m_segment)
+            munmap(m_segment, m_segmentSize);
+
+        m_segment = static_cast<char *>(segment);
+        m_segmentIndex = index;
+        m_pos = index == 0 ? FileHeaderSize : 0;
+        return true;
+#endif
+    }
+
+    /// @brief Move past the records already in the mapped segment
+    void SkipRecords() {
+        std::uint32_t size{};
+        while (m_pos + RecordHeaderSize <= m_segmentSize) {
+            std::memcpy(&size, m_segment + m_pos, 4);
+            if (size < RecordHeaderSize || size > m_segmentSize - m_pos)
+                break;
+
+            m_pos += size;
+        }
+    }
+};
+
+struct SnapshotVariable {
+    std::string name{};
+    std::string value{};
+};
+
+struct SnapshotFrame {
+    std::string declaration{};
+    std::string section{};
+    int line{};
+    std::vector<SnapshotVariable> variables{};
+};
+
+/// @brief A stop recorded by AsdbgBackend::EnableSnapshots
+struct Snapshot {
+    SnapshotKind kind{};
+    std::uint64_t timestampNs{};
+    int threadId{};
+    std::string threadName{};
+    int engineId{};
+    std::string module{};
+    /// Exception description, empty for stops
+    std::string description{};
+    bool caught{};
+    /// Top of the stack first
+    std::vector<SnapshotFrame> frames{};
+    std::vector<SnapshotVariable> globals{};
+};
+
+/// @brief Reads the records of a file written by SnapshotWriter, in order
+class SnapshotReader {
+  public:
+    /// @return false if the file cannot be read or has no valid header
+    bool Open(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        m_data.assign(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+        if (m_data.size() < SnapshotWriter::FileHeaderSize ||
+            std::memcmp(m_data.data(), "ASDBGSNP", 8) != 0)
+            return false;
+
+        std::uint32_t version{}, segmentSize{};
+        std::memcpy(&version, m_data.data() + 8, 4);
+        std::memcpy(&segmentSize, m_data.data() + 12, 4);
+        if (version != SnapshotWriter::FormatVersion || segmentSize == 0)
+            return false;
+
+        m_segmentSize = segmentSize;
+        m_segmentStart = 0;
+        m_pos = SnapshotWriter::FileHeaderSize;
+        return true;
+    }
+
+    /// @return false after the last record
+    bool Next(Snapshot &snapshot) {
+        while (m_segmentStart < m_data.size()) {
+            const size_t segmentEnd =
+                std::min(m_segmentStart + m_segmentSize, m_data.size());
+            std::uint32_t size{};
+            if (m_pos + SnapshotWriter::RecordHeaderSize <= segmentEnd)
+                std::memcpy(&size, m_data.data() + m_pos, 4);
+
+            if (size < SnapshotWriter::RecordHeaderSize ||
+                size > segmentEnd - m_pos) {
+                m_segmentStart += m_segmentSize;
+                m_pos = m_segmentStart;
+                continue;
+            }
+
+            m_end = m_pos + size;
+            m_pos += 4;
+            snapshot = Snapshot{};
+            snapshot.kind = static_cast<SnapshotKind>(ReadU32());
+            std::memcpy(&snapshot.timestampNs, m_data.data() + m_pos, 8);
+            m_pos += 8;
+            if (!ReadPayload(snapshot))
+                std::cerr << "Truncated snapshot record.\n";
+
+            m_pos = m_end;
+            return true;
+        }
+
+        return false;
+    }
+
+  private:
+    std::vector<char> m_data{};
+    size_t m_segmentSize{};
+    size_t m_segmentStart{};
+    size_t m_pos{};
+    size_t m_end{};
+
+    bool ReadPayload(Snapshot &snapshot) {
+        snapshot.threadId = static_cast<int>(ReadU32());
+        snapshot.threadName = ReadString();
+        snapshot.engineId = static_cast<int>(ReadU32());
+        snapshot.module = ReadString();
+        snapshot.description = ReadString();
+        snapshot.caught = ReadU8() != 0;
+
+        const std::uint32_t frameCount = ReadU32();
+        for (std::uint32_t i = 0; i < frameCount && m_pos < m_end; ++i) {
+            SnapshotFrame frame{};
+            frame.declaration = ReadString();
+            frame.section = ReadString();
+            frame.line = static_cast<int>(ReadU32());
+            ReadVariables(frame.variables);
+            snapshot.frames.push_back(std::move(frame));
+        }
+
+        ReadVariables(snapshot.globals);
+        return m_pos <= m_end;
+    }
+
+    void ReadVariables(std::vector<SnapshotVariable> &variables) {
+        const std::uint32_t count = ReadU32();
+        for (std::uint32_t i = 0; i < count && m_pos < m_end; ++i) {
+            SnapshotVariable variable{};
+            variable.name = ReadString();
+            variable.value = ReadString();
+            variables.push_back(std::move(variable));
+        }
+    }
+
+    std::uint8_t ReadU8() {
+        std::uint8_t value{};
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::uint32_t ReadU32() {
+        std::uint32_t value{};
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::string ReadString() {
+        const std::uint32_t size = ReadU32();
+        if (size > m_end - std::min(m_pos, m_end)) {
+            m_pos = m_end + 1;
+            return {};
+        }
+
+        std::string str(m_data.data() + m_pos, size);
+        m_pos += size;
+        return str;
+    }
+
+    void ReadBytes(void *out, size_t size) {
+        if (m_pos + size > m_end) {
+            m_pos = m_end + 1;
+            return;
+        }
+
+        std::memcpy(out, m_data.data() + m_pos, size);
+        m_pos += size;
+    }
+};
+
+class AsdbgBackend {
+  public:
+    /// FindBreakpoint is timed once per this many line callbacks of a
+    /// context, as reading the clock costs more than a lookup
+    static constexpr std::uint64_t FindBreakpointSampleRate = 64;
+
+    AsdbgBackend() = default;
+
+    /// @brief Start detached and connect to the debugger in the background.
+    /// The backend reconnects whenever the connection is lost, so the game
+    /// never waits for the debugger.
+    void Start(std::atomic<bool> &running,
+               const transport::TransportOptions &options = {},
+               const ReconnectPolicy &policy = {}) {
+        if (m_connectionThread.joinable())
+            return;
+
+        simple_socket::init();
+        m_stopping = false;
+        m_connectionThread = std::thread(
+            [this, &running, options, policy]() {
+                RunConnectionLoop(running, options, policy);
+            });
+    }
+
+    void Shutdown() {
+        if (!m_connectionThread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock{m_commandMutex};
+            m_stopping = true;
+        }
+
+        m_commandCondition.notify_all();
+
+        {
+            std::lock_guard<std::mutex> lock{m_sendMutex};
+            if (m_transport)
+                m_transport->Close();
+        }
+
+        m_connectionThread.join();
+        simple_socket::cleanup();
+    }
+
+    /// @return true while a debugger is connected
+    ASDBG_NODISCARD
+    bool IsAttached() const {
+        return m_attached.load(std::memory_order_acquire);
+    }
+
+    /// @brief Name an engine, so that the debugger can tell the threads of
+    /// several engines apart. Engines are known to the backend from their
+    /// contexts and modules without this, but unnamed.
+    void AttachEngine(asIScriptEngine *engine, const std::string &name) {
+        int engineId{};
+        {
+            std::lock_guard<std::mutex> lock{m_breankpointMutex};
+            auto &state = GetEngineState(engine);
+            state.name = name;
+            engineId = state.engineId;
+        }
+
+        if (IsAttached())
+            SendEngine(engineId, name);
+    }
+
+    /// @brief Show the values of a registered host type with a formatter
+    /// instead of the type name and address. Format appends to the buffer
+    /// that all values of a stop are formatted into, so it should not build
+    /// strings of its own:
+    /// ```
+    /// void FormatVector3(std::string &out, const Vector3 &v) {
+    ///     char buffer[64];
+    ///     out.append(buffer, std::snprintf(buffer, sizeof(buffer),
+    ///                                      "(%g, %g, %g)", v.x, v.y, v.z));
+    /// }
+    ///
+    /// g_asdbg.RegisterFormatter<Vector3, &FormatVector3>(engine, "vector3");
+    /// ```
+    /// Register before the engine runs scripts.
+    /// @return false if the type is not a registered object type, or a value
+    /// type whose size differs from T
+    template <typename T, void (*Format)(std::string &, const T &)>
+    bool RegisterFormatter(asIScriptEngine *engine, const char *typeName) {
+        const int typeId = engine->GetTypeIdByDecl(typeName);
+        asITypeInfo *type =
+            typeId < 0 ? nullptr : engine->GetTypeInfoById(typeId);
+        if (!type || (typeId & asTYPEID_MASK_OBJECT) == 0 ||
+            ((type->GetFlags() & asOBJ_VALUE) && type->GetSize() != sizeof(T)))
+            return false;
+
+        const auto index = static_cast<size_t>(typeId & asTYPEID_MASK_SEQNBR);
+        std::lock_guard<std::mutex> lock{m_breankpointMutex};
+        auto &formatters = GetEngineState(engine).formatters;
+        if (formatters.size() <= index)
+            formatters.resize(index + 1);
+
+        formatters[index] = &detail::FormatValue<T, Format>;
+        return true;
+    }
+
+    /// @brief Register the debugging intrinsics with the engine:
+    /// ```
+    /// void debugBreak()
+    /// void assert(bool condition, const string &in message = "")
+    /// void trace(const string &in message)
+    /// ```
+    /// debugBreak() stops like a breakpoint, a failed assert() stops like an
+    /// uncaught exception and trace() prints to the debug console at its
+    /// line. They do not go through the line callback, and cost one atomic
+    /// load while no debugger is connected. Register the string type first;
+    /// without it only debugBreak() and assert(bool) are registered.
+    /// @return false if the engine refused a function
+    bool RegisterIntrinsics(asIScriptEngine *engine) {
+        bool ok = engine->RegisterGlobalFunction(
+                      "void debugBreak()",
+                      asMETHOD(AsdbgBackend, ScriptDebugBreak),
+                      asCALL_THISCALL_ASGLOBAL, this) >= 0;
+
+        const int stringTypeId = engine->GetStringFactoryReturnTypeId();
+        asITypeInfo *stringType = engine->GetTypeInfoById(stringTypeId);
+        if (!stringType || stringType->GetSize() != sizeof(std::string)) {
+            ok = engine->RegisterGlobalFunction(
+                     "void assert(bool condition)",
+                     asMETHOD(AsdbgBackend, ScriptAssertCondition),
+                     asCALL_THISCALL_ASGLOBAL, this) >= 0 &&
+                 ok;
+            return ok;
+        }
+
+        const std::string messageParam =
+            "const " + std::string(stringType->GetName()) + " &in message";
+        ok = engine->RegisterGlobalFunction(
+                 ("void assert(bool condition, " + messageParam + " = \"\")")
+                     .c_str(),
+                 asMETHOD(AsdbgBackend, ScriptAssert),
+                 asCALL_THISCALL_ASGLOBAL, this) >= 0 &&
+             ok;
+        ok = engine->RegisterGlobalFunction(
+                 ("void trace(" + messageParam + ")").c_str(),
+                 asMETHOD(AsdbgBackend, ScriptTrace),
+                 asCALL_THISCALL_ASGLOBAL, this) >= 0 &&
+             ok;
+        return ok;
+    }
+
+    /// @brief Register the context with the debugger, which shows it as a
+    /// thread with its own stepping. The line callback is only installed
+    /// while a debugger is connected, so a detached backend costs nothing per
+    /// line. The exception callback is always installed, as it costs nothing
+    /// until a script throws.
+    void AttachContext(asIScriptContext *ctx, const std::string &name = {}) {
+        ctx->SetExceptionCallback(asMETHOD(AsdbgBackend, ExceptionCallback),
+                                  this, asCALL_THISCALL);
+
+        std::unique_ptr<ContextState> state{new ContextState{}};
+        {
+            std::lock_guard<std::mutex> lock{m_breankpointMutex};
+            state->engine = &GetEngineState(ctx->GetEngine());
+        }
+
+        std::lock_guard<std::mutex> lock{m_contextMutex};
+        state->ctx = ctx;
+        state->threadId = m_nextThreadId++;
+        state->name = name.empty()
+                          ? "Context " + std::to_string(state->threadId)
+                          : name;
+        ctx->SetUserData(state.get(), ContextUserDataType);
+
+        if (IsAttached()) {
+            InstallLineCallback(ctx);
+            SendThreadStarted(*state);
+        }
+
+        m_contexts.push_back(std::move(state));
+    }
+
+    /// @brief Call before releasing a context passed to AttachContext
+    void DetachContext(asIScriptContext *ctx) {
+        std::lock_guard<std::mutex> lock{m_contextMutex};
+        const auto found = std::find_if(
+            m_contexts.begin(), m_contexts.end(),
+            [ctx](const std::unique_ptr<ContextState> &state) {
+                return state->ctx == ctx;
+            });
+        if (found != m_contexts.end()) {
+            if (IsAttached())
+                Send("THREAD_EXITED\n" + std::to_string((*found)->threadId) +
+                     "\n");
+
+            m_detachedLineCallbacks.fetch_add(
+                (*found)->lineCallbacks.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            m_contexts.erase(found);
+        }
+
+        ctx->SetUserData(nullptr, ContextUserDataType);
+        ctx->ClearLineCallback();
+        ctx->ClearExceptionCallback();
+    }
+
+    /// @brief Serve asIScriptEngine::RequestContext from contexts attached to
+    /// the backend. This covers the threads and co-routines of CContextMgr,
+    /// which request their contexts from the engine. A pooled context is
+    /// shown as a thread while it is out of the pool.
+    void EnableContextPool(asIScriptEngine *engine) {
+        engine->SetContextCallbacks(RequestPooledContext, ReturnPooledContext,
+                                    this);
+    }
+
+    /// @brief Release the pooled contexts of the engine. Call before shutting
+    /// down the engine.
+    void ReleaseContextPool(asIScriptEngine *engine) {
+        engine->SetContextCallbacks(nullptr, nullptr, nullptr);
+
+        std::lock_guard<std::mutex> lock{m_poolMutex};
+        auto it = m_contextPool.begin();
+        while (it != m_contextPool.end()) {
+            if ((*it)->GetEngine() == engine) {
+                (*it)->Release();
+                it = m_contextPool.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// @brief Run work requested by the debugger that needs a script thread,
+    /// such as a GC census, when no script is running. Call regularly, e.g.
+    /// once per frame, from a thread that runs scripts of the engine.
+    void Update(asIScriptEngine *engine) {
+        if (m_censusRequested.load(std::memory_order_relaxed))
+            StepCensus(engine);
+    }
+
+    /// @brief Number of objects a GC census visits per line cue or Update
+    void SetCensusSliceSize(asUINT objectCount) {
+        m_censusSliceSize = std::max<asUINT>(1, objectCount);
+    }
+
+    /// @brief Replace the breakpoints without going through the debugger,
+    /// e.g. to restore them from a previous session or in benchmarks
+    void SetBreakpoints(std::vector<Breakpoint> breakpoints) {
+        ApplyBreakpoints(std::move(breakpoints));
+    }
+
+    /// @brief Index the lines with code of a module, once built, so that
+    /// breakpoints in its sections are moved to the next line with code up
+    /// front and the debugger can query valid breakpoint locations. Each
+    /// engine has its own index, and lines of modules indexed before are
+    /// kept.
+    void IndexModule(asIScriptModule *module) {
+        std::vector<Breakpoint> requested{};
+        {
+            std::lock_guard<std::mutex> lock{m_breankpointMutex};
+            GetEngineState(module->GetEngine()).lineIndex.AddModule(module);
+            requested = m_requestedBreakpoints;
+        }
+
+        ApplyBreakpoints(std::move(requested));
+    }
+
+    /// @brief Record every stop and exception as a snapshot appended to the
+    /// file, for post-mortem analysis where no debugger can be attached.
+    /// Exceptions are recorded while no debugger is connected too, as the
+    /// exception breakpoint mode selects them. snapshot_replay feeds the file
+    /// back to the debugger.
+    /// @return false if the file cannot be mapped
+    bool EnableSnapshots(const std::string &path,
+                         size_t segmentSize = 4 * 1024 * 1024) {
+        std::lock_guard<std::mutex> lock{m_snapshotMutex};
+        const bool opened = m_snapshots.Open(path, segmentSize);
+        m_snapshotsEnabled = opened;
+        return opened;
+    }
+
+    void DisableSnapshots() {
+        std::lock_guard<std::mutex> lock{m_snapshotMutex};
+        m_snapshotsEnabled = false;
+        m_snapshots.Close();
+    }
+
+    /// @brief Global variables, by name, recorded with each snapshot from the
+    /// module stopped in
+    void SetSnapshotGlobals(std::vector<std::string> names) {
+        std::lock_guard<std::mutex> lock{m_snapshotMutex};
+        m_snapshotGlobals = std::move(names);
+    }
+
+    /// @brief Counters and histograms of the backend's own overhead
+    ASDBG_NODISCARD
+    BackendMetrics GetMetrics() {
+        BackendMetrics metrics{};
+        metrics.lineCallbacks =
+            m_detachedLineCallbacks.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock{m_contextMutex};
+            for (const auto &state : m_contexts) {
+                metrics.lineCallbacks +=
+                    state->lineCallbacks.load(std::memory_order_relaxed);
+            }
+        }
+
+        metrics.bytesSent = m_bytesSent.load(std::memory_order_relaxed);
+        metrics.bytesReceived =
+            m_bytesReceived.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock{m_metricsMutex};
+            metrics.messagesSent = m_messagesSent;
+            metrics.messagesReceived = m_messagesReceived;
+        }
+
+        metrics.findBreakpoint = m_findBreakpointTime.Summarize();
+        metrics.stopToResume = m_stopToResumeTime.Summarize();
+        metrics.variableSerialization = m_variableSerializationTime.Summarize();
+        return metrics;
+    }
+
+    /// @brief Interval of the METRICS messages pushed to the debugger, or 0
+    /// to push none
+    void SetMetricsInterval(int intervalMs) {
+        m_metricsIntervalMs = std::max(0, intervalMs);
+    }
+
+    /// @brief Line callback installed by AttachContext
+    void LineCallback(asIScriptContext *ctx) {
+        ContextState *state = GetContextState(ctx);
+        if (!IsAttached() || !state) {
+            DropLineCallback(ctx, state);
+            return;
+        }
+
+        // Only this thread writes the count, so no read-modify-write is
+        // needed
+        const auto lineCallbacks =
+            state->lineCallbacks.load(std::memory_order_relaxed) + 1;
+        state->lineCallbacks.store(lineCallbacks, std::memory_order_relaxed);
+
+        if (m_censusRequested.load(std::memory_order_relaxed))
+            StepCensus(ctx->GetEngine());
+
+        const char *filename{};
+        const auto lineNumber = ctx->GetLineNumber(0, nullptr, &filename);
+        if (!filename)
+            return; // e.g. a registered function without script section
+
+        if (IsStepFinished(*state, lineNumber)) {
+            // A breakpoint on the same line must not stop a second time
+            const auto filepath = GetAbsolutePath(filename);
+            Stop(*state, Breakpoint{filepath, lineNumber});
+            return;
+        }
+
+        const Breakpoint *bp{};
+        if (lineCallbacks % FindBreakpointSampleRate == 0) {
+            const auto start = std::chrono::steady_clock::now();
+            bp = FindBreakpoint(*state->engine, filename, lineNumber);
+            m_findBreakpointTime.Record(std::chrono::steady_clock::now() -
+                                        start);
+        } else {
+            bp = FindBreakpoint(*state->engine, filename, lineNumber);
+        }
+
+        if (bp) {
+            std::cout << "Breakpoint hit: " << filename << ", " << lineNumber
+                      << "\n";
+
+            Stop(*state, *bp);
+        }
+    }
+
+    /// @brief Exception callback installed by AttachContext. It is called
+    /// before the stack unwinds, so the locals of the throwing frame are still
+    /// alive.
+    void ExceptionCallback(asIScriptContext *ctx) {
+        ContextState *state = GetContextState(ctx);
+        const bool recording =
+            m_snapshotsEnabled.load(std::memory_order_relaxed);
+        if ((!IsAttached() && !recording) || !state)
+            return;
+
+        const auto mode = m_exceptionBreakMode.load(std::memory_order_relaxed);
+        const bool caught = ctx->WillExceptionBeCaught();
+        if (mode == ExceptionBreakMode::Never ||
+            (mode == ExceptionBreakMode::Uncaught && caught))
+            return;
+
+        const char *section{};
+        const int line = ctx->GetExceptionLineNumber(nullptr, &section);
+        const char *description = ctx->GetExceptionString();
+        if (recording) {
+            RecordSnapshot(*state, SnapshotKind::Exception, section, line,
+                           description ? description : "", caught);
+        }
+
+        if (!IsAttached())
+            return;
+
+        StopAtException(*state, section, line, description, caught);
+    }
+
+    ASDBG_NODISCARD
+    std::string GetAbsolutePath(const std::string &filename) { // FIXME!
+        // TODO
+        for (const auto &bp : m_requestedBreakpoints) {
+            if (detail::EndWith(bp.filepath, filename)) {
+                return bp.filepath;
+            }
+        }
+
+        return filename;
+    }
+
+    /// @brief Stop at the breakpoint in VSCode and wait for the command from
+    /// the debugger
+    ///
+    /// ```
+    /// STOP
+    /// thread id
+    /// filepath,line
+    /// engine id:module
+    /// ```
+    ASDBG_NODISCARD
+    DebugCommand TriggerBreakpoint(asIScriptContext *ctx,
+                                   const Breakpoint &bp) {
+        ContextState *state = GetContextState(ctx);
+        if (!state)
+            return DebugCommand::Continue;
+
+        std::string request = "STOP\n";
+        request += std::to_string(state->threadId) + "\n";
+        request += bp.filepath + "," + std::to_string(bp.line) + "\n";
+        request += ModuleTag(*state) + "\n";
+        if (m_snapshotsEnabled.load(std::memory_order_relaxed)) {
+            const char *section{};
+            ctx->GetLineNumber(0, nullptr, &section);
+            RecordSnapshot(*state, SnapshotKind::Stop, section, bp.line, "",
+                           false);
+        }
+
+        const auto stopStart = std::chrono::steady_clock::now();
+        BeginStop(state->threadId);
+        Send(request);
+
+        SendVariables(*state);
+
+        const auto cmd = WaitForCommand(*state);
+        m_stopToResumeTime.Record(std::chrono::steady_clock::now() -
+                                  stopStart);
         return cmd;
     }
 
     ~AsdbgBackend() { Shutdown(); }
 
   private:
-    int m_socket{-1};
+    /// asIScriptContext user data type of ContextState
+    static constexpr asPWORD ContextUserDataType = 0x61736462; // "asdb"
+
+    /// @brief Hashes of the variables the debugger has for one frame
+    struct FrameSnapshot {
+        asUINT depth{};
+        std::unordered_map<std::string, std::uint64_t> hashes{};
+    };
+
+    /// @brief Breakpoints resolved against a line index, kept so that the
+    /// same breakpoints over the same lines are armed again without
+    /// resolving them, e.g. when the debugger reconnects or a module is
+    /// rebuilt from unchanged sources
+    struct ResolvedBreakpoints {
+        /// Hash of the requested breakpoints and of the line index
+        std::uint64_t key{};
+        /// Sorted by line
+        std::vector<Breakpoint> breakpoints{};
+        /// BREAKPOINTS_RESOLVED entries
+        std::string moves{};
+        size_t moveCount{};
+    };
+
+    static constexpr size_t ResolvedCacheSize = 8;
+
+    /// @brief An engine seen by the backend, with the lines with code of its
+    /// modules and the breakpoints resolved against them
+    struct EngineState {
+        asIScriptEngine *engine{};
+        int engineId{};
+        std::string name{};
+        LineIndex lineIndex{};
+        /// Sorted by line for FindBreakpoint
+        std::vector<Breakpoint> breakpoints{};
+        /// Most recently armed first
+        std::vector<ResolvedBreakpoints> resolvedCache{};
+        /// Indexed by the sequence number of the type id
+        std::vector<detail::ValueFormatter> formatters{};
+    };
+
+    /// @brief A context attached to the backend, shown as a thread. Apart
+    /// from the ids and the line callback count, it is only used on the
+    /// context's own thread.
+    struct ContextState {
+        asIScriptContext *ctx{};
+        int threadId{};
+        std::string name{};
+        EngineState *engine{};
+        std::atomic<std::uint64_t> lineCallbacks{0};
+
+        DebugCommand previousCommand{};
+        /// Call stack size and line where the step started
+        asUINT stepDepth{};
+        int stepLine{};
+
+        int snapshotConnection{-1};
+        std::unordered_map<std::string, FrameSnapshot> frameSnapshots{};
+        std::unordered_map<std::string, std::uint64_t> scratchHashes{};
+        std::string valueBuffer{};
+    };
+
+    std::thread m_connectionThread{};
+    std::atomic<bool> m_attached{false};
+    std::shared_ptr<transport::ITransport> m_transport{};
+    std::mutex m_sendMutex{};
     std::mutex m_breankpointMutex{};
-    std::vector<Breakpoint> m_breankpointList{};
-    std::atomic<DebugCommand> m_debugCommand{DebugCommand::Nothing};
+    /// Breakpoints as set in the debugger, before moving them to lines with
+    /// code
+    std::vector<Breakpoint> m_requestedBreakpoints{};
+    std::vector<std::unique_ptr<EngineState>> m_engines{};
+    int m_nextEngineId{1};
+    std::atomic<ExceptionBreakMode> m_exceptionBreakMode{
+        ExceptionBreakMode::Uncaught};
+    std::mutex m_contextMutex{};
+    std::vector<std::unique_ptr<ContextState>> m_contexts{};
+    int m_nextThreadId{1};
+    std::mutex m_poolMutex{};
+    std::vector<asIScriptContext *> m_contextPool{};
+    std::mutex m_commandMutex{};
+    std::condition_variable m_commandCondition{};
+    /// Commands received for stopped threads, by thread id
+    std::unordered_map<int, DebugCommand> m_commands{};
+    std::vector<int> m_stoppedThreads{};
+    bool m_stopping{};
+
+    /// Incremented per connection, so snapshots sent to a previous debugger
+    /// are not used as the base of a delta
+    std::atomic<int> m_connectionCount{0};
+
+    std::atomic<bool> m_censusRequested{false};
+    std::atomic<asUINT> m_censusSliceSize{4096};
+    std::mutex m_censusMutex{};
+    GcCensus m_census{};
+
+    std::atomic<int> m_metricsIntervalMs{5000};
+    /// Line callbacks of the contexts detached so far
+    std::atomic<std::uint64_t> m_detachedLineCallbacks{0};
+    std::atomic<std::uint64_t> m_bytesSent{0};
+    std::atomic<std::uint64_t> m_bytesReceived{0};
+    std::mutex m_metricsMutex{};
+    std::map<std::string, std::uint64_t> m_messagesSent{};
+    std::map<std::string, std::uint64_t> m_messagesReceived{};
+    DurationHistogram m_findBreakpointTime{};
+    DurationHistogram m_stopToResumeTime{};
+    DurationHistogram m_variableSerializationTime{};
+
+    std::atomic<bool> m_snapshotsEnabled{false};
+    std::mutex m_snapshotMutex{};
+    SnapshotWriter m_snapshots{};
+    std::vector<std::string> m_snapshotGlobals{};
+
+    static ContextState *GetContextState(asIScriptContext *ctx) {
+        return static_cast<ContextState *>(
+            ctx->GetUserData(ContextUserDataType));
+    }
+
+    /// @brief Find or add the engine. Call with m_breankpointMutex held.
+    EngineState &GetEngineState(asIScriptEngine *engine) {
+        for (const auto &state : m_engines) {
+            if (state->engine == engine)
+                return *state;
+        }
+
+        std::unique_ptr<EngineState> state{new EngineState{}};
+        state->engine = engine;
+        state->engineId = m_nextEngineId++;
+        state->breakpoints = m_requestedBreakpoints;
+        SortByLine(state->breakpoints);
+        m_engines.push_back(std::move(state));
+        return *m_engines.back();
+    }
+
+    /// @return Breakpoint if found, otherwise nullptr
+    ASDBG_NODISCARD
+    const Breakpoint *FindBreakpoint(const EngineState &engine,
+                                     const std::string &filepath, int line) {
+        std::lock_guard<std::mutex> lock{m_breankpointMutex};
+
+        const auto &breakpoints = engine.breakpoints;
+        auto bp = std::lower_bound(
+            breakpoints.begin(), breakpoints.end(), line,
+            [](const Breakpoint &bp, int line) { return bp.line < line; });
+        for (; bp != breakpoints.end() && bp->line == line; ++bp) {
+            // TODO: Compare absolute path
+            if (detail::AreSameFiles(bp->filepath, filepath))
+                return &*bp;
+        }
+
+        return nullptr;
+    }
 
-    void SendBreakpointsRequest() {
-        std::string send = "GET_BREAKPOINTS\n";
-        simple_socket::send_data(m_socket, send.c_str(), send.size());
+    static void SortByLine(std::vector<Breakpoint> &breakpoints) {
+        std::stable_sort(breakpoints.begin(), breakpoints.end(),
+                         [](const Breakpoint &a, const Breakpoint &b) {
+                             return a.line < b.line;
+                         });
     }
 
-    void SendVariables() {
-        std::string send = "VARIABLES\n";
-        send += "3\n"; // count
-        send += "initial_player_life\n123\n";
-        send += "player_damage\n0xFFE0\n";
-        send += "player_life\n987\n";
+    ASDBG_NODISCARD
+    static std::uint64_t HashBreakpoints(
+        const std::vector<Breakpoint> &breakpoints) {
+        std::uint64_t hash = detail::HashBytes(nullptr, 0);
+        for (const auto &bp : breakpoints) {
+            hash = detail::HashBytes(bp.filepath.data(), bp.filepath.size(),
+                                     hash);
+            hash = detail::HashBytes(reinterpret_cast<const char *>(&bp.line),
+                                     sizeof(bp.line), hash);
+        }
 
-        simple_socket::send_data(m_socket, send.c_str(), send.size());
+        return hash;
     }
 
-    void StartReceiverThread(std::atomic<bool> &running) {
-        std::thread([this, &running]() {
-            char tmpBuffer[1024];
+    /// @brief "engine id:module" of the function running at the top of the
+    /// context
+    static std::string ModuleTag(const ContextState &state) {
+        asIScriptFunction *func = state.ctx->GetFunction(0);
+        const char *module = func ? func->GetModuleName() : nullptr;
+        return std::to_string(state.engine->engineId) + ":" +
+               (module ? module : "");
+    }
 
-            while (running) {
-                const int len = simple_socket::receive_data(
-                    m_socket, tmpBuffer, sizeof(tmpBuffer) - 1);
-                if (len <= 0) {
-                    std::cerr << "Disconnected or error.\n";
-                    running = false;
+    static asIScriptContext *RequestPooledContext(asIScriptEngine *engine,
+                                                  void *param) {
+        auto *self = static_cast<AsdbgBackend *>(param);
+        asIScriptContext *ctx{};
+        {
+            std::lock_guard<std::mutex> lock{self->m_poolMutex};
+            auto &pool = self->m_contextPool;
+            for (auto it = pool.rbegin(); it != pool.rend(); ++it) {
+                if ((*it)->GetEngine() == engine) {
+                    ctx = *it;
+                    pool.erase(std::next(it).base());
                     break;
                 }
+            }
+        }
+
+        if (!ctx)
+            ctx = engine->CreateContext();
 
-                tmpBuffer[len] = '\0';
+        self->AttachContext(ctx);
+        return ctx;
+    }
 
-                string_view bufferView = tmpBuffer;
-                std::cout << "Received:\n" << bufferView.data() << "\n";
-                auto messageQueue = detail::MessageQueue{bufferView};
+    static void ReturnPooledContext(asIScriptEngine *, asIScriptContext *ctx,
+                                    void *param) {
+        auto *self = static_cast<AsdbgBackend *>(param);
+        self->DetachContext(ctx);
+        ctx->Unprepare();
 
-                while (!messageQueue.IsEmpty()) {
-                    if (ParseBeakpoints(messageQueue)) {
-                        continue;
-                    } else if (ParseCommand(messageQueue)) {
+        std::lock_guard<std::mutex> lock{self->m_poolMutex};
+        self->m_contextPool.push_back(ctx);
+    }
+
+    /// @return true if the line ends the step the debugger asked for. A line
+    /// may report several line cues, which do not count as a step.
+    static bool IsStepFinished(const ContextState &state, int line) {
+        const asUINT depth = state.ctx->GetCallstackSize();
+        switch (state.previousCommand) {
+        case DebugCommand::StepIn:
+            return depth != state.stepDepth || line != state.stepLine;
+        case DebugCommand::StepOver:
+            // Not inside a function called from the line the step started on
+            return depth < state.stepDepth ||
+                   (depth == state.stepDepth && line != state.stepLine);
+        default:
+            return false;
+        }
+    }
+
+    void Stop(ContextState &state, const Breakpoint &bp) {
+        state.previousCommand = TriggerBreakpoint(state.ctx, bp);
+        state.stepDepth = state.ctx->GetCallstackSize();
+        state.stepLine = bp.line;
+    }
+
+    /// @brief Mark the thread as stopped before reporting the stop, so that a
+    /// quick answer is not lost. A command that arrived while the thread was
+    /// running is dropped, so it is not taken as the answer to this stop.
+    void BeginStop(int threadId) {
+        std::lock_guard<std::mutex> lock{m_commandMutex};
+        m_commands.erase(threadId);
+        m_stoppedThreads.push_back(threadId);
+    }
+
+    /// @brief Wait for the command from the debugger after BeginStop. Losing
+    /// the debugger resumes the script. A GC census requested meanwhile is
+    /// taken while waiting.
+    DebugCommand WaitForCommand(const ContextState &state) {
+        const int threadId = state.threadId;
+        bool helpCensus = true;
+        std::unique_lock<std::mutex> lock{m_commandMutex};
+        while (true) {
+            m_commandCondition.wait(lock, [this, threadId, helpCensus]() {
+                return m_commands.find(threadId) != m_commands.end() ||
+                       !IsAttached() || m_stopping ||
+                       (helpCensus && m_censusRequested);
+            });
+
+            if (m_commands.find(threadId) != m_commands.end() ||
+                !IsAttached() || m_stopping)
+                break;
+
+            // The script is paused, so this thread can take the census
+            lock.unlock();
+            helpCensus = StepCensus(state.ctx->GetEngine());
+            lock.lock();
+        }
+
+        m_stoppedThreads.erase(std::find(m_stoppedThreads.begin(),
+                                         m_stoppedThreads.end(), threadId));
+
+        const auto found = m_commands.find(threadId);
+        if (found == m_commands.end())
+            return DebugCommand::Continue;
+
+        const auto cmd = found->second;
+        m_commands.erase(found);
+        return cmd;
+    }
+
+    void InstallLineCallback(asIScriptContext *ctx) {
+        // SetLineCallback publishes the function before enabling it, so it
+        // may be called while the context is executing on another thread
+        ctx->SetLineCallback(asMETHOD(AsdbgBackend, LineCallback), this,
+                             asCALL_THISCALL);
+    }
+
+    /// @brief Called on the context's own thread after the debugger left
+    void DropLineCallback(asIScriptContext *ctx, ContextState *state) {
+        if (state)
+            state->previousCommand = DebugCommand::Nothing;
+
+        // Re-check under the lock, in case a new connection has just
+        // installed the callback again
+        std::lock_guard<std::mutex> lock{m_contextMutex};
+        if (!IsAttached() || !state)
+            ctx->ClearLineCallback();
+    }
+
+    void RunConnectionLoop(std::atomic<bool> &running,
+                           const transport::TransportOptions &options,
+                           const ReconnectPolicy &policy) {
+        int delayMs = policy.initialDelayMs;
+        while (running && !IsStopping()) {
+            std::shared_ptr<transport::ITransport> transport =
+                transport::Connect(options);
+            if (!transport) {
+                // Nobody is listening yet; try again later
+                std::unique_lock<std::mutex> lock{m_commandMutex};
+                m_commandCondition.wait_for(
+                    lock, std::chrono::milliseconds(delayMs),
+                    [this]() { return m_stopping; });
+                delayMs = std::min(delayMs * 2, policy.maxDelayMs);
+                continue;
+            }
+
+            delayMs = policy.initialDelayMs;
+            OnAttached(transport);
+            ReceiveMessages(running, *transport);
+            OnDetached();
+        }
+    }
+
+    bool IsStopping() {
+        std::lock_guard<std::mutex> lock{m_commandMutex};
+        return m_stopping;
+    }
+
+    void OnAttached(const std::shared_ptr<transport::ITransport> &transport) {
+        {
+            std::lock_guard<std::mutex> lock{m_sendMutex};
+            m_transport = transport;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{m_commandMutex};
+            m_commands.clear();
+        }
+
+        m_connectionCount.fetch_add(1, std::memory_order_release);
+        std::cout << "Debugger attached.\n";
+        SendBreakpointsRequest();
+
+        std::lock_guard<std::mutex> lock{m_contextMutex};
+        m_attached.store(true, std::memory_order_release);
+
+        {
+            // Engines named after this are announced by AttachEngine
+            std::lock_guard<std::mutex> engineLock{m_breankpointMutex};
+            for (const auto &engine : m_engines) {
+                SendEngine(engine->engineId, engine->name);
+            }
+        }
+
+        // ```
+        // THREADS
+        // number of threads
+        // thread id
+        // name
+        // engine id
+        // ...
+        // ```
+        std::string threads = "THREADS\n";
+        threads += std::to_string(m_contexts.size()) + "\n";
+        for (const auto &state : m_contexts) {
+            InstallLineCallback(state->ctx);
+            threads += std::to_string(state->threadId) + "\n";
+            threads += state->name + "\n";
+            threads += std::to_string(state->engine->engineId) + "\n";
+        }
+
+        Send(threads);
+    }
+
+    void OnDetached() {
+        {
+            std::lock_guard<std::mutex> lock{m_contextMutex};
+            m_attached.store(false, std::memory_order_release);
+        }
+
+        m_censusRequested = false;
+
+        {
+            std::lock_guard<std::mutex> lock{m_sendMutex};
+            m_transport->Close();
+            m_transport.reset();
+        }
+
+        // Resume a script waiting at a breakpoint. Taking the lock orders the
+        // notification after the waiter's predicate check.
+        { std::lock_guard<std::mutex> lock{m_commandMutex}; }
+        m_commandCondition.notify_all();
+        std::cout << "Debugger detached.\n";
+    }
+
+    /// @brief Send a whole message. Transports are single-producer, so
+    /// concurrent senders are serialized here.
+    void Send(const std::string &message) {
+        {
+            std::lock_guard<std::mutex> lock{m_sendMutex};
+            if (!m_transport ||
+                m_transport->Send(message.data(), message.size()) < 0)
+                return;
+        }
+
+        m_bytesSent.fetch_add(message.size(), std::memory_order_relaxed);
+        const auto typeEnd = std::min(message.find('\n'), message.size());
+        CountMessage(m_messagesSent, string_view(message.data(), typeEnd));
+    }
+
+    void CountMessage(std::map<std::string, std::uint64_t> &counts,
+                      string_view type) {
+        std::lock_guard<std::mutex> lock{m_metricsMutex};
+        counts[std::string(type.data(), type.size())]++;
+    }
+
+    /// @brief Push the metrics to the debugger
+    ///
+    /// ```
+    /// METRICS
+    /// line callbacks
+    /// bytes sent
+    /// bytes received
+    /// number of histograms
+    /// name
+    /// count
+    /// total ns
+    /// max ns
+    /// p50 ns
+    /// p99 ns
+    /// ...
+    /// number of message types
+    /// sent|received:type
+    /// count
+    /// ...
+    /// ```
+    void SendMetrics() {
+        const auto metrics = GetMetrics();
+
+        std::string message = "METRICS\n";
+        message += std::to_string(metrics.lineCallbacks) + "\n";
+        message += std::to_string(metrics.bytesSent) + "\n";
+        message += std::to_string(metrics.bytesReceived) + "\n";
+
+        const std::pair<const char *, const DurationHistogram::Summary *>
+            histograms[] = {
+                {"find_breakpoint", &metrics.findBreakpoint},
+                {"stop_to_resume", &metrics.stopToResume},
+                {"variable_serialization", &metrics.variableSerialization},
+            };
+        message += std::to_string(sizeof(histograms) / sizeof(histograms[0])) +
+                   "\n";
+        for (const auto &histogram : histograms) {
+            const auto &summary = *histogram.second;
+            message += std::string(histogram.first) + "\n";
+            message += std::to_string(summary.count) + "\n";
+            message += std::to_string(summary.totalNs) + "\n";
+            message += std::to_string(summary.maxNs) + "\n";
+            message += std::to_string(summary.p50Ns) + "\n";
+            message += std::to_string(summary.p99Ns) + "\n";
+        }
+
+        message += std::to_string(metrics.messagesSent.size() +
+                                  metrics.messagesReceived.size()) +
+                   "\n";
+        for (const auto &entry : metrics.messagesSent) {
+            message += "sent:" + entry.first + "\n" +
+                       std::to_string(entry.second) + "\n";
+        }
+
+        for (const auto &entry : metrics.messagesReceived) {
+            message += "received:" + entry.first + "\n" +
+                       std::to_string(entry.second) + "\n";
+        }
+
+        Send(message);
+    }
+
+    void SendBreakpointsRequest() { Send("GET_BREAKPOINTS\n"); }
+
+    /// @brief Install the breakpoints, moved to the next line with code in
+    /// the sections each engine has indexed. Breakpoints after the last line
+    /// with code are dropped. An engine that had the same breakpoints over
+    /// the same lines before gets them from its cache.
+    void ApplyBreakpoints(std::vector<Breakpoint> requested) {
+        // ```
+        // BREAKPOINTS_RESOLVED
+        // number of breakpoints in indexed sections, per engine
+        // filepath,requested line,resolved line (0 if dropped)
+        // ...
+        // ```
+        std::string moves{};
+        size_t moveCount{};
+        {
+            const std::uint64_t requestedHash = HashBreakpoints(requested);
+            std::lock_guard<std::mutex> lock{m_breankpointMutex};
+            for (const auto &engine : m_engines) {
+                const std::uint64_t indexHash = engine->lineIndex.Hash();
+                const std::uint64_t key = detail::HashBytes(
+                    reinterpret_cast<const char *>(&indexHash),
+                    sizeof(indexHash), requestedHash);
+
+                auto &cache = engine->resolvedCache;
+                const auto cached = std::find_if(
+                    cache.begin(), cache.end(),
+                    [key](const ResolvedBreakpoints &entry) {
+                        return entry.key == key;
+                    });
+                if (cached != cache.end()) {
+                    std::rotate(cache.begin(), cached, cached + 1);
+                } else {
+                    cache.insert(cache.begin(),
+                                 Resolve(engine->lineIndex, requested, key));
+                    if (cache.size() > ResolvedCacheSize)
+                        cache.pop_back();
+                }
+
+                const auto &resolved = cache.front();
+                engine->breakpoints = resolved.breakpoints;
+                moves += resolved.moves;
+                moveCount += resolved.moveCount;
+            }
+
+            m_requestedBreakpoints = std::move(requested);
+        }
+
+        if (moveCount > 0) {
+            Send("BREAKPOINTS_RESOLVED\n" + std::to_string(moveCount) + "\n" +
+                 moves);
+        }
+    }
+
+    static ResolvedBreakpoints Resolve(const LineIndex &index,
+                                       const std::vector<Breakpoint> &requested,
+                                       std::uint64_t key) {
+        ResolvedBreakpoints resolved{};
+        resolved.key = key;
+        for (const auto &bp : requested) {
+            if (!index.HasSection(bp.filepath)) {
+                resolved.breakpoints.push_back(bp);
+                continue;
+            }
+
+            const int line = index.FindLineWithCode(bp.filepath, bp.line);
+            if (line > 0)
+                resolved.breakpoints.push_back(Breakpoint{bp.filepath, line});
+
+            resolved.moves += bp.filepath;
+            detail::AppendFormat(resolved.moves, ",%d,%d\n", bp.line, line);
+            resolved.moveCount++;
+        }
+
+        SortByLine(resolved.breakpoints);
+        return resolved;
+    }
+
+    /// @brief Visit the next slice of the census requested by the debugger
+    /// @return false if the census cannot progress on this thread, i.e. it is
+    /// taken on another engine
+    bool StepCensus(asIScriptEngine *engine) {
+        std::lock_guard<std::mutex> lock{m_censusMutex};
+        if (!m_censusRequested)
+            return true; // Finished on another thread
+
+        if (!m_census.IsStarted())
+            m_census.Begin(engine);
+
+        if (m_census.GetEngine() != engine)
+            return false;
+
+        if (!m_census.Step(m_censusSliceSize)) {
+            asUINT total{};
+            engine->GetGCStatistics(&total);
+            Send("GC_CENSUS_PROGRESS\n" + std::to_string(m_census.Visited()) +
+                 "\n" + std::to_string(total) + "\n");
+            return true;
+        }
+
+        SendCensus();
+        m_census.End();
+        m_censusRequested = false;
+        return true;
+    }
+
+    /// ```
+    /// GC_CENSUS
+    /// number of objects visited
+    /// objects currently in the GC
+    /// objects destroyed so far
+    /// garbage detected so far
+    /// number of types
+    /// type declaration
+    /// objects
+    /// approximate bytes
+    /// objects in the new generation
+    /// objects in the old generation
+    /// ...
+    /// number of arrays
+    /// type declaration
+    /// length
+    /// approximate bytes
+    /// ...
+    /// ```
+    void SendCensus() {
+        asIScriptEngine *engine = m_census.GetEngine();
+        asUINT currentSize{}, totalDestroyed{}, totalDetected{};
+        engine->GetGCStatistics(&currentSize, &totalDestroyed, &totalDetected);
+
+        std::string message = "GC_CENSUS\n";
+        message += std::to_string(m_census.Visited()) + "\n";
+        message += std::to_string(currentSize) + "\n";
+        message += std::to_string(totalDestroyed) + "\n";
+        message += std::to_string(totalDetected) + "\n";
+
+        const auto types = m_census.Types();
+        message += std::to_string(types.size()) + "\n";
+        for (const auto &entry : types) {
+            message +=
+                engine->GetTypeDeclaration(entry.type->GetTypeId(), true);
+            message += "\n" + std::to_string(entry.count) + "\n" +
+                       std::to_string(entry.bytes) + "\n" +
+                       std::to_string(entry.newCount) + "\n" +
+                       std::to_string(entry.oldCount) + "\n";
+        }
+
+        const auto &arrays = m_census.LargestArrays();
+        message += std::to_string(arrays.size()) + "\n";
+        for (const auto &entry : arrays) {
+            message +=
+                engine->GetTypeDeclaration(entry.type->GetTypeId(), true);
+            message += "\n" + std::to_string(entry.length) + "\n" +
+                       std::to_string(entry.bytes) + "\n";
+        }
+
+        Send(message);
+    }
+
+    /// @brief "THREAD_STARTED" followed by the thread id and name
+    /// ```
+    /// THREAD_STARTED
+    /// thread id
+    /// name
+    /// engine id
+    /// ```
+    void SendThreadStarted(const ContextState &state) {
+        Send("THREAD_STARTED\n" + std::to_string(state.threadId) + "\n" +
+             state.name + "\n" + std::to_string(state.engine->engineId) +
+             "\n");
+    }
+
+    /// ```
+    /// ENGINE
+    /// engine id
+    /// name
+    /// ```
+    void SendEngine(int engineId, const std::string &name) {
+        Send("ENGINE\n" + std::to_string(engineId) + "\n" + name + "\n");
+    }
+
+    /// @brief debugBreak() of RegisterIntrinsics
+    void ScriptDebugBreak() {
+        if (!IsAttached())
+            return;
+
+        asIScriptContext *ctx = asGetActiveContext();
+        ContextState *state = ctx ? GetContextState(ctx) : nullptr;
+        if (!state)
+            return;
+
+        const char *section{};
+        const int line = ctx->GetLineNumber(0, nullptr, &section);
+        Stop(*state, Breakpoint{GetAbsolutePath(section ? section : ""), line});
+    }
+
+    /// @brief assert() of RegisterIntrinsics. A failed assertion is reported
+    /// as an uncaught exception, and recorded as one when snapshots are on.
+    void ScriptAssert(bool condition, const std::string &message) {
+        if (condition)
+            return;
+
+        const bool recording =
+            m_snapshotsEnabled.load(std::memory_order_relaxed);
+        if (!IsAttached() && !recording)
+            return;
+
+        asIScriptContext *ctx = asGetActiveContext();
+        ContextState *state = ctx ? GetContextState(ctx) : nullptr;
+        if (!state)
+            return;
+
+        const std::string description = message.empty()
+                                            ? "Assertion failed"
+                                            : "Assertion failed: " + message;
+        const char *section{};
+        const int line = ctx->GetLineNumber(0, nullptr, &section);
+        if (recording) {
+            RecordSnapshot(*state, SnapshotKind::Exception, section, line,
+                           description.c_str(), false);
+        }
+
+        if (IsAttached())
+            StopAtException(*state, section, line, description.c_str(), false);
+    }
+
+    void ScriptAssertCondition(bool condition) {
+        if (!condition)
+            ScriptAssert(condition, {});
+    }
+
+    /// @brief trace() of RegisterIntrinsics
+    ///
+    /// ```
+    /// TRACE
+    /// thread id
+    /// filepath,line
+    /// message
+    /// ```
+    void ScriptTrace(const std::string &message) {
+        if (!IsAttached())
+            return;
+
+        asIScriptContext *ctx = asGetActiveContext();
+        ContextState *state = ctx ? GetContextState(ctx) : nullptr;
+        if (!state)
+            return;
+
+        const char *section{};
+        const int line = ctx->GetLineNumber(0, nullptr, &section);
+        std::string send = "TRACE\n";
+        send += std::to_string(state->threadId) + "\n";
+        send += GetAbsolutePath(section ? section : "") + "," +
+                std::to_string(line) + "\n";
+        detail::AppendEscaped(send, message);
+        send += "\n";
+        Send(send);
+    }
+
+    /// @brief Stop as if the script threw at the line, and wait for the
+    /// command from the debugger
+    ///
+    /// ```
+    /// EXCEPTION
+    /// thread id
+    /// filepath,line
+    /// engine id:module
+    /// description
+    /// 1 if a try/catch will catch it, otherwise 0
+    /// number of frames
+    /// declaration
+    /// filepath,line
+    /// ...
+    /// ```
+    ///
+    /// It is followed by the variables of the throwing frame.
+    void StopAtException(ContextState &state, const char *section, int line,
+                         const char *description, bool caught) {
+        asIScriptContext *ctx = state.ctx;
+        std::string message = "EXCEPTION\n";
+        message += std::to_string(state.threadId) + "\n";
+        message += GetAbsolutePath(section ? section : "") + "," +
+                   std::to_string(line) + "\n";
+        message += ModuleTag(state) + "\n";
+        detail::AppendEscaped(message, description ? description : "");
+        message += "\n";
+        message += caught ? "1\n" : "0\n";
+
+        const asUINT stackSize = ctx->GetCallstackSize();
+        message += std::to_string(stackSize) + "\n";
+        for (asUINT level = 0; level < stackSize; ++level) {
+            asIScriptFunction *func = ctx->GetFunction(level);
+            const char *frameSection = section;
+            int frameLine = line;
+            if (level > 0)
+                frameLine = ctx->GetLineNumber(level, nullptr, &frameSection);
+
+            message += func ? func->GetDeclaration() : "?";
+            message += "\n";
+            message += GetAbsolutePath(frameSection ? frameSection : "") +
+                       "," + std::to_string(frameLine) + "\n";
+        }
+
+        const auto stopStart = std::chrono::steady_clock::now();
+        BeginStop(state.threadId);
+        Send(message);
+        SendVariables(state);
+
+        state.previousCommand = WaitForCommand(state);
+        m_stopToResumeTime.Record(std::chrono::steady_clock::now() -
+                                  stopStart);
+        state.stepDepth = ctx->GetCallstackSize();
+        state.stepLine = line;
+    }
+
+    /// @brief Append the stack, the locals of every frame and the selected
+    /// globals to the snapshot file. Values are formatted into the context's
+    /// buffer and copied into the mapping, so nothing is allocated per
+    /// snapshot once the buffer has grown.
+    ///
+    /// ```
+    /// i32     thread id
+    /// string  thread name (u32 size and bytes)
+    /// i32     engine id
+    /// string  module
+    /// string  exception description, empty for stops
+    /// u8      1 if a try/catch will catch the exception
+    /// u32     number of frames, top first
+    /// string  declaration
+    /// string  section
+    /// i32     line
+    /// u32     number of variables
+    /// string  name
+    /// string  value
+    /// ...
+    /// u32     number of globals
+    /// string  name
+    /// string  value
+    /// ...
+    /// ```
+    void RecordSnapshot(ContextState &state, SnapshotKind kind,
+                        const char *section, int line, const char *description,
+                        bool caught) {
+        asIScriptContext *ctx = state.ctx;
+        asIScriptEngine *engine = ctx->GetEngine();
+        asIScriptFunction *top = ctx->GetFunction(0);
+        asIScriptModule *module = top ? top->GetModule() : nullptr;
+
+        std::lock_guard<std::mutex> lock{m_snapshotMutex};
+        const bool recorded = m_snapshots.Append(kind, [&](SnapshotWriter
+                                                               &out) {
+            out.WriteI32(state.threadId);
+            out.WriteString(state.name);
+            out.WriteI32(state.engine->engineId);
+            out.WriteString(module ? module->GetName() : "");
+            out.WriteString(description);
+            out.WriteU8(caught ? 1 : 0);
+
+            const asUINT stackSize = ctx->GetCallstackSize();
+            out.WriteU32(stackSize);
+            for (asUINT level = 0; level < stackSize; ++level) {
+                asIScriptFunction *func = ctx->GetFunction(level);
+                const char *frameSection = section;
+                int frameLine = line;
+                if (level > 0)
+                    frameLine =
+                        ctx->GetLineNumber(level, nullptr, &frameSection);
+
+                out.WriteString(func ? func->GetDeclaration() : "?");
+                out.WriteString(frameSection ? frameSection : "");
+                out.WriteI32(frameLine);
+
+                const size_t countPos = out.ReserveU32();
+                std::uint32_t count{};
+                const int varCount = ctx->GetVarCount(level);
+                for (int i = 0; i < varCount; ++i) {
+                    const char *name{};
+                    int typeId{};
+                    ctx->GetVar(i, level, &name, &typeId);
+                    if (!name || !name[0] || !ctx->IsVarInScope(i, level))
                         continue;
-                    } else {
-                        std::cout
-                            << "Unknown message: " << messageQueue.Pop().data()
-                            << std::endl;
-                    }
+
+                    state.valueBuffer.clear();
+                    detail::AppendValue(state.valueBuffer, engine,
+                                        ctx->GetAddressOfVar(i, level), typeId,
+                                        &state.engine->formatters);
+                    out.WriteString(name);
+                    out.WriteString(state.valueBuffer);
+                    count++;
+                }
+
+                out.PatchU32(countPos, count);
+            }
+
+            const size_t countPos = out.ReserveU32();
+            std::uint32_t count{};
+            for (const auto &name : m_snapshotGlobals) {
+                const int index =
+                    module ? module->GetGlobalVarIndexByName(name.c_str())
+                           : -1;
+                if (index < 0)
+                    continue;
+
+                int typeId{};
+                module->GetGlobalVar(static_cast<asUINT>(index), nullptr,
+                                     nullptr, &typeId);
+                state.valueBuffer.clear();
+                detail::AppendValue(state.valueBuffer, engine,
+                                    module->GetAddressOfGlobalVar(index),
+                                    typeId, &state.engine->formatters);
+                out.WriteString(name);
+                out.WriteString(state.valueBuffer);
+                count++;
+            }
+
+            out.PatchU32(countPos, count);
+        });
+
+        if (!recorded)
+            std::cerr << "Snapshot dropped: larger than a segment.\n";
+    }
+
+    /// @brief Send the local variables of the stopped frame as a delta
+    /// against what the debugger received at the previous stop in the same
+    /// frame. Called on the context's own thread only.
+    ///
+    /// ```
+    /// VARIABLES_DELTA
+    /// frame key
+    /// 1 if the debugger should drop what it has for the frame, otherwise 0
+    /// number of added or changed variables
+    /// name
+    /// value
+    /// ...
+    /// number of removed variables
+    /// name
+    /// ...
+    /// ```
+    void SendVariables(ContextState &state) {
+        asIScriptContext *ctx = state.ctx;
+        asIScriptFunction *func = ctx->GetFunction(0);
+        if (!func)
+            return;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        const int connection =
+            m_connectionCount.load(std::memory_order_acquire);
+        if (state.snapshotConnection != connection) {
+            state.frameSnapshots.clear();
+            state.snapshotConnection = connection;
+        }
+
+        // Frames deeper than the stopped one have returned
+        const asUINT depth = ctx->GetCallstackSize();
+        for (auto it = state.frameSnapshots.begin();
+             it != state.frameSnapshots.end();) {
+            if (it->second.depth > depth) {
+                it = state.frameSnapshots.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        const std::string frameKey = std::to_string(state.threadId) + ":" +
+                                     std::to_string(depth) + ":" +
+                                     std::to_string(func->GetId());
+        const bool reset =
+            state.frameSnapshots.find(frameKey) == state.frameSnapshots.end();
+        auto &snapshot = state.frameSnapshots[frameKey];
+        snapshot.depth = depth;
+
+        asIScriptEngine *engine = ctx->GetEngine();
+        state.scratchHashes.clear();
+
+        std::string changed{};
+        size_t changedCount{};
+        const int varCount = ctx->GetVarCount(0);
+        for (int i = 0; i < varCount; ++i) {
+            const char *name{};
+            int typeId{};
+            ctx->GetVar(i, 0, &name, &typeId);
+            if (!name || !name[0] || !ctx->IsVarInScope(i, 0))
+                continue;
+
+            state.valueBuffer.clear();
+            detail::AppendValue(state.valueBuffer, engine,
+                                ctx->GetAddressOfVar(i, 0), typeId,
+                                &state.engine->formatters);
+            const auto hash = detail::HashBytes(state.valueBuffer.data(),
+                                                state.valueBuffer.size());
+            state.scratchHashes[name] = hash;
+
+            const auto previous = snapshot.hashes.find(name);
+            if (previous != snapshot.hashes.end() && previous->second == hash)
+                continue;
+
+            changed += name;
+            changed += '\n';
+            changed += state.valueBuffer;
+            changed += '\n';
+            changedCount++;
+        }
+
+        std::string removed{};
+        size_t removedCount{};
+        for (const auto &entry : snapshot.hashes) {
+            if (state.scratchHashes.find(entry.first) !=
+                state.scratchHashes.end())
+                continue;
+
+            removed += entry.first;
+            removed += '\n';
+            removedCount++;
+        }
+
+        snapshot.hashes.swap(state.scratchHashes);
+
+        std::string send = "VARIABLES_DELTA\n";
+        send += frameKey + "\n";
+        send += reset ? "1\n" : "0\n";
+        send += std::to_string(changedCount) + "\n";
+        send += changed;
+        send += std::to_string(removedCount) + "\n";
+        send += removed;
+
+        m_variableSerializationTime.Record(std::chrono::steady_clock::now() -
+                                           start);
+        Send(send);
+    }
+
+    void ReceiveMessages(std::atomic<bool> &running,
+                         transport::ITransport &transport) {
+        char tmpBuffer[1024];
+        std::string pending{};
+        auto nextMetrics = std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds(m_metricsIntervalMs);
+
+        while (running) {
+            // Push the metrics while waiting for data
+            const int intervalMs = m_metricsIntervalMs.load();
+            if (intervalMs > 0) {
+                const auto now = std::chrono::steady_clock::now();
+                if (now >= nextMetrics) {
+                    SendMetrics();
+                    nextMetrics = now + std::chrono::milliseconds(intervalMs);
                 }
+
+                const auto timeoutMs =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        nextMetrics - now)
+                        .count();
+                if (!transport.WaitReadable(static_cast<int>(timeoutMs) + 1) &&
+                    std::chrono::steady_clock::now() >= nextMetrics)
+                    continue; // Otherwise Receive reports the disconnection
+            }
+
+            const int len = transport.Receive(tmpBuffer, sizeof(tmpBuffer));
+            if (len <= 0) {
+                std::cerr << "Disconnected or error.\n";
+                break;
+            }
+
+            m_bytesReceived.fetch_add(len, std::memory_order_relaxed);
+
+            std::cout << "Received:\n" << std::string(tmpBuffer, len) << "\n";
+
+            // Messages are not framed, so a large breakpoint list may be
+            // split across several chunks. Only complete lines are parsed and
+            // an incomplete message waits for the next chunk.
+            pending.append(tmpBuffer, len);
+            const auto lastNewline = pending.rfind('\n');
+            if (lastNewline == std::string::npos)
+                continue;
+
+            auto messageQueue = detail::MessageQueue{
+                string_view(pending.data(), lastNewline + 1)};
+            pending.erase(0, ParseMessages(messageQueue));
+        }
+    }
+
+    /// @return Number of bytes consumed from the queue source
+    size_t ParseMessages(detail::MessageQueue &queue) {
+        while (!queue.IsEmpty()) {
+            const auto offset = queue.Offset();
+
+            const auto type = queue.Peek();
+            auto result = ParseBeakpoints(queue);
+            if (result == detail::ParseResult::Unmatched)
+                result = ParseExceptionBreakpoints(queue);
+            if (result == detail::ParseResult::Unmatched)
+                result = ParseCommand(queue);
+            if (result == detail::ParseResult::Unmatched)
+                result = ParseGcCensus(queue);
+            if (result == detail::ParseResult::Unmatched)
+                result = ParseBreakpointLocations(queue);
+
+            if (result == detail::ParseResult::Incomplete)
+                return offset;
+
+            CountMessage(m_messagesReceived,
+                         result == detail::ParseResult::Parsed ? type
+                                                               : "unknown");
+
+            if (result == detail::ParseResult::Unmatched) {
+                const auto unknown = queue.Pop();
+                std::cout << "Unknown message: "
+                          << std::string(unknown.data(), unknown.size())
+                          << std::endl;
             }
-        }).detach();
+        }
+
+        return queue.Offset();
     }
 
-    bool ParseBeakpoints(detail::MessageQueue &queue) {
+    detail::ParseResult ParseBeakpoints(detail::MessageQueue &queue) {
         while (!queue.IsEmpty()) {
             if (queue.Peek() != "BREAKPOINTS")
-                return false;
+                return detail::ParseResult::Unmatched;
 
-            queue.Pop();
+            if (!queue.Contains("END_BREAKPOINTS"))
+                return detail::ParseResult::Incomplete;
 
-            {
-                std::lock_guard<std::mutex> lock{m_breankpointMutex};
-                m_breankpointList.clear();
-            }
+            queue.Pop();
 
+            std::vector<Breakpoint> breakpoints{};
             while (!queue.IsEmpty()) {
                 const auto next = queue.Pop();
                 if (next == "END_BREAKPOINTS") {
                     break;
                 }
 
-                std::istringstream lineStream(next.data());
+                std::istringstream lineStream(
+                    std::string(next.data(), next.size()));
                 std::string filepath, line;
 
                 try {
@@ -445,10 +3336,7 @@ class AsdbgBackend {
                             "Failed to parse line number.");
 
                     const int lineNumber = std::stoi(line);
-
-                    std::lock_guard<std::mutex> lock{m_breankpointMutex};
-                    m_breankpointList.push_back(
-                        Breakpoint{filepath, lineNumber});
+                    breakpoints.push_back(Breakpoint{filepath, lineNumber});
 
                     std::cout << "Parsed breakpoint: " << filepath << ", "
                               << lineNumber << std::endl;
@@ -458,33 +3346,166 @@ class AsdbgBackend {
                 }
             }
 
+            ApplyBreakpoints(std::move(breakpoints));
             break;
         }
 
-        return true;
+        return detail::ParseResult::Parsed;
     }
 
-    bool ParseCommand(detail::MessageQueue &queue) {
-        if (queue.Peek() != "COMMAND")
-            return false;
+    /// @brief Lines with code in a range of a file, answered with the same
+    /// request id. No lines are reported for files not indexed.
+    /// ```
+    /// BREAKPOINT_LOCATIONS
+    /// request id
+    /// filepath
+    /// start line
+    /// end line
+    /// ```
+    detail::ParseResult
+    ParseBreakpointLocations(detail::MessageQueue &queue) {
+        if (queue.Peek() != "BREAKPOINT_LOCATIONS")
+            return detail::ParseResult::Unmatched;
+
+        if (queue.Remaining() < 5)
+            return detail::ParseResult::Incomplete;
 
         queue.Pop();
+        const auto requestId = queue.Pop();
+        const auto filepath = queue.Pop();
+        int startLine{}, endLine{};
+        const bool valid = detail::ParseInt(queue.Pop(), startLine) &&
+                           detail::ParseInt(queue.Pop(), endLine);
+
+        // Lines with code in any engine
+        std::vector<int> lines{};
+        if (valid) {
+            std::lock_guard<std::mutex> lock{m_breankpointMutex};
+            for (const auto &engine : m_engines) {
+                const auto engineLines = engine->lineIndex.LinesWithCode(
+                    filepath, startLine, endLine);
+                lines.insert(lines.end(), engineLines.begin(),
+                             engineLines.end());
+            }
+        }
 
-        if (queue.IsEmpty())
-            return false;
+        std::sort(lines.begin(), lines.end());
+        lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+        // ```
+        // BREAKPOINT_LOCATIONS
+        // request id
+        // number of lines
+        // line
+        // ...
+        // ```
+        std::string message = "BREAKPOINT_LOCATIONS\n";
+        message.append(requestId.data(), requestId.size());
+        message += "\n" + std::to_string(lines.size()) + "\n";
+        for (const int line : lines) {
+            detail::AppendFormat(message, "%d\n", line);
+        }
+
+        Send(message);
+        return detail::ParseResult::Parsed;
+    }
+
+    /// @brief "EXCEPTION_BREAKPOINTS" followed by "none", "uncaught" or "all"
+    detail::ParseResult
+    ParseExceptionBreakpoints(detail::MessageQueue &queue) {
+        if (queue.Peek() != "EXCEPTION_BREAKPOINTS")
+            return detail::ParseResult::Unmatched;
+
+        if (queue.Remaining() < 2)
+            return detail::ParseResult::Incomplete;
+
+        queue.Pop();
+
+        const auto next = queue.Pop();
+        if (next == "none") {
+            m_exceptionBreakMode = ExceptionBreakMode::Never;
+        } else if (next == "uncaught") {
+            m_exceptionBreakMode = ExceptionBreakMode::Uncaught;
+        } else if (next == "all") {
+            m_exceptionBreakMode = ExceptionBreakMode::All;
+        } else {
+            std::cerr << "Unknown exception breakpoint filter: "
+                      << std::string(next.data(), next.size()) << std::endl;
+        }
+
+        return detail::ParseResult::Parsed;
+    }
+
+    /// @brief "COMMAND", optionally followed by the thread id, and the
+    /// command. A command without thread id applies to every stopped thread.
+    detail::ParseResult ParseCommand(detail::MessageQueue &queue) {
+        if (queue.Peek() != "COMMAND")
+            return detail::ParseResult::Unmatched;
+
+        if (queue.Remaining() < 2)
+            return detail::ParseResult::Incomplete;
+
+        int threadId{};
+        const bool hasThreadId = detail::ParseInt(queue.Peek(1), threadId);
+        if (hasThreadId && queue.Remaining() < 3)
+            return detail::ParseResult::Incomplete;
+
+        queue.Pop();
+        if (hasThreadId)
+            queue.Pop();
 
         const auto next = queue.Pop();
+        DebugCommand cmd{DebugCommand::Nothing};
         if (next == "STEP_OVER") {
-            m_debugCommand.store(DebugCommand::StepOver);
+            cmd = DebugCommand::StepOver;
         } else if (next == "STEP_IN") {
-            m_debugCommand.store(DebugCommand::StepIn);
+            cmd = DebugCommand::StepIn;
         } else if (next == "CONTINUE") {
-            m_debugCommand.store(DebugCommand::Continue);
+            cmd = DebugCommand::Continue;
         } else {
-            std::cerr << "Unknown command: " << next.data() << std::endl;
+            std::cerr << "Unknown command: "
+                      << std::string(next.data(), next.size()) << std::endl;
+            return detail::ParseResult::Parsed;
         }
 
-        return true;
+        {
+            std::lock_guard<std::mutex> lock{m_commandMutex};
+            if (hasThreadId) {
+                m_commands[threadId] = cmd;
+            } else {
+                for (const auto stopped : m_stoppedThreads) {
+                    m_commands[stopped] = cmd;
+                }
+            }
+        }
+
+        m_commandCondition.notify_all();
+
+        return detail::ParseResult::Parsed;
+    }
+
+    /// @brief "GC_CENSUS" starts a census over, which script threads then
+    /// take slice by slice
+    detail::ParseResult ParseGcCensus(detail::MessageQueue &queue) {
+        if (queue.Peek() != "GC_CENSUS")
+            return detail::ParseResult::Unmatched;
+
+        queue.Pop();
+
+        {
+            std::lock_guard<std::mutex> lock{m_censusMutex};
+            m_census.End();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{m_commandMutex};
+            m_censusRequested = true;
+        }
+
+        // Paused scripts take the census while waiting for a command
+        m_commandCondition.notify_all();
+
+        return detail::ParseResult::Parsed;
     }
 }; // class AsdbgBackend
 
@@ -0,0 +1,11 @@
+void main() {
+    int sum = 0;
+    double acc = 1.0;
+    for (int i = 0; i < 200000; i++) {
+        sum += i * 3 - (i >> 2);
+        acc = acc * 1.000001 + 0.5;
+        if (sum > 1000000) {
+            sum -= 1000000;
+        }
+    }
+}
@@ -0,0 +1,16 @@
+void main() {
+    array<int> values;
+    dictionary table;
+    for (int i = 0; i < 20000; i++) {
+        values.insertLast(i);
+        table.set("key" + (i % 256), i);
+        if (values.length() > 512) {
+            values.removeRange(0, 256);
+        }
+    }
+
+    int total = 0;
+    for (uint i = 0; i < values.length(); i++) {
+        total += values[i];
+    }
+}
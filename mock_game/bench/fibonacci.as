@@ -0,0 +1,13 @@
+int fibonacci(int n) {
+    if (n <= 1) {
+        return n;
+    }
+
+    const auto v1 = fibonacci(n - 1);
+    const auto v2 = fibonacci(n - 2);
+    return v1 + v2;
+}
+
+void main() {
+    const auto result = fibonacci(24);
+}
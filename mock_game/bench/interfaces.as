@@ -0,0 +1,47 @@
+interface IController {
+    int update(int tick);
+}
+
+class Walker : IController {
+    int position = 0;
+
+    int update(int tick) {
+        position += 1;
+        return position;
+    }
+}
+
+class Runner : IController {
+    int position = 0;
+
+    int update(int tick) {
+        position += 3;
+        return position;
+    }
+}
+
+class Idler : IController {
+    int update(int tick) {
+        return 0;
+    }
+}
+
+void main() {
+    array<IController@> entities;
+    for (int i = 0; i < 64; i++) {
+        if (i % 3 == 0) {
+            entities.insertLast(Walker());
+        } else if (i % 3 == 1) {
+            entities.insertLast(Runner());
+        } else {
+            entities.insertLast(Idler());
+        }
+    }
+
+    int total = 0;
+    for (int tick = 0; tick < 2000; tick++) {
+        for (uint i = 0; i < entities.length(); i++) {
+            total += entities[i].update(tick);
+        }
+    }
+}
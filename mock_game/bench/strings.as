@@ -0,0 +1,9 @@
+void main() {
+    string text;
+    for (int i = 0; i < 20000; i++) {
+        text += "item" + i + ",";
+        if (text.length() > 4096) {
+            text = "";
+        }
+    }
+}
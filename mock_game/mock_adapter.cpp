@@ -0,0 +1,605 @@
+// Headless stand-in for the VSCode debug adapter (AsdbgSession).
+//
+// Listens on port 4712 like the extension does, launches the engine as a
+// child process and drives a scripted session against asdbg_backend.hpp:
+// set N breakpoints, step K times, continue C times. It reports per-operation
+// latency percentiles and the CPU time the engine process spent, so debugger
+// performance can be regression-tested without VSCode.
+//
+// Usage:
+//   ./mock_adapter.exe [options] -- ./mock_engine.exe [engine args...]
+//
+// The engine learns the transport through the ASDBG_TRANSPORT environment
+// variable. POSIX only; the shared-memory transport needs Linux.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <climits>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "asdbg_backend.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using asdbg::transport::ITransport;
+using asdbg::transport::TransportKind;
+
+struct Options {
+    TransportKind transport{TransportKind::Tcp};
+    std::string socketPath{"/tmp/asdbg.sock"};
+    int port{4712};
+    int breakpointCount{10};
+    int stepCount{20};
+    int continueCount{5};
+    int timeoutMs{10000};
+    std::vector<std::string> hitBreakpoints{};
+    std::vector<std::string> engineArgs{};
+};
+
+// -----------------------------------------------
+
+/// @brief Line-oriented reader over a transport. The backend does not frame
+/// its messages, so lines may arrive split across several Receive() calls.
+class LineReader {
+  public:
+    explicit LineReader(ITransport &transport) : m_transport(transport) {}
+
+    /// @return false on timeout or disconnect
+    bool ReadLine(std::string &line, int timeoutMs) {
+        const auto deadline =
+            Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while (true) {
+            const auto newline = m_buffer.find('\n', m_pos);
+            if (newline != std::string::npos) {
+                line.assign(m_buffer, m_pos, newline - m_pos);
+                m_pos = newline + 1;
+                if (m_pos == m_buffer.size()) {
+                    m_buffer.clear();
+                    m_pos = 0;
+                }
+
+                return true;
+            }
+
+            const auto remaining =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - Clock::now())
+                    .count();
+            if (remaining <= 0)
+                return false;
+
+            if (!m_transport.WaitReadable(static_cast<int>(remaining)))
+                return false;
+
+            char tmpBuffer[4096];
+            const auto len = m_transport.Receive(tmpBuffer, sizeof(tmpBuffer));
+            if (len <= 0)
+                return false;
+
+            m_bytesReceived += len;
+            m_buffer.append(tmpBuffer, len);
+        }
+    }
+
+    size_t BytesReceived() const { return m_bytesReceived; }
+
+  private:
+    ITransport &m_transport;
+    std::string m_buffer{};
+    size_t m_pos{};
+    size_t m_bytesReceived{};
+};
+
+class LatencyRecorder {
+  public:
+    void Add(const std::string &operation, Clock::duration elapsed) {
+        m_samples[operation].push_back(
+            std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+
+    void Print() const {
+        std::printf("%-12s %6s %10s %10s %10s %10s\n", "operation", "count",
+                    "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+        for (const auto &entry : m_samples) {
+            auto samples = entry.second;
+            std::sort(samples.begin(), samples.end());
+            std::printf("%-12s %6zu %10.1f %10.1f %10.1f %10.1f\n",
+                        entry.first.c_str(), samples.size(),
+                        Percentile(samples, 0.50), Percentile(samples, 0.90),
+                        Percentile(samples, 0.99), samples.back());
+        }
+    }
+
+  private:
+    std::map<std::string, std::vector<double>> m_samples{};
+
+    static double Percentile(const std::vector<double> &sorted, double p) {
+        const auto index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+};
+
+// -----------------------------------------------
+
+class StandInSession {
+  public:
+    StandInSession(const Options &options, ITransport &transport)
+        : m_options(options), m_transport(transport), m_reader(transport) {}
+
+    bool Run() {
+        const auto connectedAt = Clock::now();
+        if (!Expect("GET_BREAKPOINTS"))
+            return false;
+
+        m_latency.Add("attach", Clock::now() - connectedAt);
+
+        SendBreakpoints();
+
+        // The first stop comes from one of the hit breakpoints
+        if (!WaitStop("first_stop"))
+            return false;
+
+        for (int i = 0; i < m_options.stepCount; ++i) {
+            Send("COMMAND\nSTEP_IN\n");
+            if (!WaitStop("step"))
+                return false;
+        }
+
+        for (int i = 0; i < m_options.continueCount; ++i) {
+            Send("COMMAND\nCONTINUE\n");
+            if (!WaitStop("continue"))
+                return false;
+        }
+
+        // Let the engine run freely from here on
+        Send("COMMAND\nCONTINUE\n");
+        return true;
+    }
+
+    void PrintReport() const {
+        m_latency.Print();
+        std::printf("bytes sent: %zu, bytes received: %zu\n", m_bytesSent,
+                    m_reader.BytesReceived());
+        std::printf("variables received: %zu\n", m_variablesReceived);
+    }
+
+  private:
+    const Options &m_options;
+    ITransport &m_transport;
+    LineReader m_reader;
+    LatencyRecorder m_latency{};
+    size_t m_bytesSent{};
+    size_t m_variablesReceived{};
+
+    void Send(const std::string &message) {
+        if (m_transport.Send(message.data(), message.size()) > 0)
+            m_bytesSent += message.size();
+    }
+
+    bool Expect(const std::string &expected) {
+        std::string line;
+        while (m_reader.ReadLine(line, m_options.timeoutMs)) {
+            if (line == expected)
+                return true;
+
+            if (SkipNotification(line))
+                continue;
+
+            if (!line.empty())
+                std::cerr << "Unexpected message: " << line << "\n";
+        }
+
+        std::cerr << "Timed out waiting for " << expected << "\n";
+        return false;
+    }
+
+    /// @return true if the line started an engine or thread list or event, a
+    /// trace, a report of resolved breakpoints or backend metrics, whose lines
+    /// have been skipped
+    bool SkipNotification(const std::string &line) {
+        if (line == "THREADS") {
+            int count;
+            return ReadCount(count) && SkipLines(count * 3);
+        }
+
+        if (line == "THREAD_STARTED")
+            return SkipLines(3);
+
+        if (line == "ENGINE")
+            return SkipLines(2);
+
+        if (line == "THREAD_EXITED")
+            return SkipLines(1);
+
+        if (line == "TRACE")
+            return SkipLines(3);
+
+        if (line == "BREAKPOINTS_RESOLVED") {
+            int count;
+            return ReadCount(count) && SkipLines(count);
+        }
+
+        if (line == "METRICS") {
+            int histograms, types;
+            return SkipLines(3) && ReadCount(histograms) &&
+                   SkipLines(histograms * 6) && ReadCount(types) &&
+                   SkipLines(types * 2);
+        }
+
+        return false;
+    }
+
+    void SendBreakpoints() {
+        std::string message = "BREAKPOINTS\n";
+        for (const auto &bp : m_options.hitBreakpoints) {
+            message += bp + "\n";
+        }
+
+        // Breakpoints in files the engine never runs, to load FindBreakpoint
+        const auto fillerCount =
+            m_options.breakpointCount -
+            static_cast<int>(m_options.hitBreakpoints.size());
+        for (int i = 0; i < fillerCount; ++i) {
+            message += "/bench/unrelated_" + std::to_string(i % 64) + ".as," +
+                       std::to_string(1 + i / 64) + "\n";
+        }
+
+        message += "END_BREAKPOINTS\n";
+        Send(message);
+    }
+
+    /// @brief Wait for "STOP" followed by its "VARIABLES_DELTA" block
+    bool WaitStop(const std::string &operation) {
+        const auto sentAt = Clock::now();
+        if (!Expect("STOP"))
+            return false;
+
+        const auto stoppedAt = Clock::now();
+        m_latency.Add(operation, stoppedAt - sentAt);
+
+        std::string threadId, location, moduleTag;
+        if (!m_reader.ReadLine(threadId, m_options.timeoutMs) ||
+            !m_reader.ReadLine(location, m_options.timeoutMs) ||
+            !m_reader.ReadLine(moduleTag, m_options.timeoutMs))
+            return false;
+
+        if (!Expect("VARIABLES_DELTA"))
+            return false;
+
+        std::string frameKey, reset;
+        if (!m_reader.ReadLine(frameKey, m_options.timeoutMs) ||
+            !m_reader.ReadLine(reset, m_options.timeoutMs))
+            return false;
+
+        int changedCount;
+        if (!ReadCount(changedCount) || !SkipLines(changedCount * 2))
+            return false;
+
+        int removedCount;
+        if (!ReadCount(removedCount) || !SkipLines(removedCount))
+            return false;
+
+        m_variablesReceived += changedCount;
+        m_latency.Add("variables", Clock::now() - stoppedAt);
+        return true;
+    }
+
+    bool ReadCount(int &count) {
+        std::string line;
+        if (!m_reader.ReadLine(line, m_options.timeoutMs))
+            return false;
+
+        count = std::atoi(line.c_str());
+        return true;
+    }
+
+    bool SkipLines(int count) {
+        std::string line;
+        for (int i = 0; i < count; ++i) {
+            if (!m_reader.ReadLine(line, m_options.timeoutMs))
+                return false;
+        }
+
+        return true;
+    }
+};
+
+// -----------------------------------------------
+
+int Listen(const Options &options) {
+    if (options.transport == TransportKind::Tcp) {
+        const int sock = socket(AF_INET, SOCK_STREAM, 0);
+        const int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(sock, 1) < 0) {
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    // Unix-domain socket, also the bootstrap channel for shared memory
+    const int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, options.socketPath.c_str(),
+                 sizeof(addr.sun_path) - 1);
+    unlink(options.socketPath.c_str());
+    if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(sock, 1) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+std::unique_ptr<ITransport> AcceptTransport(const Options &options,
+                                            int server) {
+    const int client = accept(server, nullptr, nullptr);
+    if (client < 0)
+        return nullptr;
+
+    switch (options.transport) {
+    case TransportKind::Tcp:
+        asdbg::simple_socket::set_no_delay(client);
+        break;
+    case TransportKind::SharedMemory:
+        return asdbg::transport::SharedMemoryTransport::Accept(client);
+    default:
+        break;
+    }
+
+    return std::unique_ptr<ITransport>(
+        new asdbg::transport::SocketTransport(client));
+}
+
+std::string TransportSpec(const Options &options) {
+    switch (options.transport) {
+    case TransportKind::UnixSocket:
+        return "unix:" + options.socketPath;
+    case TransportKind::SharedMemory:
+        return "shm:" + options.socketPath;
+    default:
+        return "tcp:127.0.0.1:" + std::to_string(options.port);
+    }
+}
+
+pid_t LaunchEngine(const Options &options) {
+    const pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    const auto &args = options.engineArgs;
+    setenv("ASDBG_TRANSPORT", TransportSpec(options).c_str(), 1);
+
+    std::vector<char *> argv;
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+
+    argv.push_back(nullptr);
+
+    // Keep the report readable; the engine is chatty on stdout
+    freopen("/dev/null", "w", stdout);
+    execv(argv[0], argv.data());
+    std::perror("execv");
+    std::_Exit(127);
+}
+
+double TicksToSeconds(unsigned long long ticks) {
+    return static_cast<double>(ticks) / sysconf(_SC_CLK_TCK);
+}
+
+/// @brief Print user+system time of each engine thread from /proc. The main
+/// thread runs the script and line callbacks; the others belong to the backend.
+void PrintThreadCpu(pid_t pid) {
+    const auto taskDir = "/proc/" + std::to_string(pid) + "/task";
+    DIR *dir = opendir(taskDir.c_str());
+    if (!dir)
+        return;
+
+    while (const dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        const auto statPath = taskDir + "/" + entry->d_name + "/stat";
+        FILE *file = std::fopen(statPath.c_str(), "r");
+        if (!file)
+            continue;
+
+        char stat[1024]{};
+        const auto len = std::fread(stat, 1, sizeof(stat) - 1, file);
+        std::fclose(file);
+        stat[len] = '\0';
+
+        // Fields after the parenthesized command name; utime and stime are the
+        // 14th and 15th fields overall.
+        const char *rest = std::strrchr(stat, ')');
+        unsigned long long utime{}, stime{};
+        if (!rest || std::sscanf(rest + 2,
+                                 "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                                 "%llu %llu",
+                                 &utime, &stime) != 2)
+            continue;
+
+        const bool isMain = std::to_string(pid) == entry->d_name;
+        std::printf("  thread %-8s %-8s user %.3fs sys %.3fs\n", entry->d_name,
+                    isMain ? "(script)" : "(backend)", TicksToSeconds(utime),
+                    TicksToSeconds(stime));
+    }
+
+    closedir(dir);
+}
+
+void PrintUsage() {
+    std::cerr
+        << "Usage: mock_adapter.exe [options] -- <engine> [engine args...]\n"
+           "  --transport T     tcp, unix or shm (default tcp)\n"
+           "  --socket-path S   socket path for unix and shm "
+           "(default /tmp/asdbg.sock)\n"
+           "  --port P          listen port for tcp (default 4712)\n"
+           "  --breakpoints N   total breakpoints to send (default 10)\n"
+           "  --bp file,line    breakpoint expected to hit (repeatable)\n"
+           "  --steps K         STEP_IN commands after the first stop "
+           "(default 20)\n"
+           "  --continues C     CONTINUE commands that must stop again "
+           "(default 5)\n"
+           "  --timeout-ms T    per-message timeout (default 10000)\n";
+}
+
+bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--") {
+            for (++i; i < argc; ++i) {
+                options.engineArgs.push_back(argv[i]);
+            }
+
+            break;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const std::string value = argv[++i];
+        if (arg == "--transport") {
+            if (value == "tcp") {
+                options.transport = TransportKind::Tcp;
+            } else if (value == "unix") {
+                options.transport = TransportKind::UnixSocket;
+            } else if (value == "shm") {
+                options.transport = TransportKind::SharedMemory;
+            } else {
+                return false;
+            }
+        } else if (arg == "--socket-path") {
+            options.socketPath = value;
+        } else if (arg == "--port") {
+            options.port = std::atoi(value.c_str());
+        } else if (arg == "--breakpoints") {
+            options.breakpointCount = std::atoi(value.c_str());
+        } else if (arg == "--bp") {
+            options.hitBreakpoints.push_back(value);
+        } else if (arg == "--steps") {
+            options.stepCount = std::atoi(value.c_str());
+        } else if (arg == "--continues") {
+            options.continueCount = std::atoi(value.c_str());
+        } else if (arg == "--timeout-ms") {
+            options.timeoutMs = std::atoi(value.c_str());
+        } else {
+            return false;
+        }
+    }
+
+    if (options.engineArgs.empty())
+        return false;
+
+    if (options.hitBreakpoints.empty()) {
+        // fibonacci() in lazy.as
+        char cwd[PATH_MAX]{};
+        if (getcwd(cwd, sizeof(cwd))) {
+            options.hitBreakpoints.push_back(std::string(cwd) + "/lazy.as,6");
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options{};
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    const int server = Listen(options);
+    if (server < 0) {
+        std::cerr << "Failed to listen on " << TransportSpec(options)
+                  << " (is VSCode running the adapter?)\n";
+        return 1;
+    }
+
+    const pid_t engine = LaunchEngine(options);
+
+    pollfd pfd{server, POLLIN, 0};
+    if (poll(&pfd, 1, options.timeoutMs) <= 0) {
+        std::cerr << "Engine did not connect.\n";
+        kill(engine, SIGKILL);
+        waitpid(engine, nullptr, 0);
+        return 1;
+    }
+
+    const auto transport = AcceptTransport(options, server);
+    if (!transport) {
+        std::cerr << "Failed to set up the transport.\n";
+        kill(engine, SIGKILL);
+        waitpid(engine, nullptr, 0);
+        return 1;
+    }
+
+    StandInSession session{options, *transport};
+    const auto startedAt = Clock::now();
+    const bool ok = session.Run();
+    const auto wallSeconds =
+        std::chrono::duration<double>(Clock::now() - startedAt).count();
+
+    std::printf("engine threads at end of session:\n");
+    PrintThreadCpu(engine);
+
+    transport->Close();
+    close(server);
+    if (options.transport != TransportKind::Tcp)
+        unlink(options.socketPath.c_str());
+
+    kill(engine, SIGTERM);
+    int status{};
+    rusage usage{};
+    wait4(engine, &status, 0, &usage);
+
+    const auto userSeconds =
+        usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    const auto systemSeconds =
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    std::printf("\n");
+    session.PrintReport();
+    std::printf("session wall %.3fs, engine cpu user %.3fs sys %.3fs "
+                "(%.1f%% of one core)\n",
+                wallSeconds, userSeconds, systemSeconds,
+                100.0 * (userSeconds + systemSeconds) / wallSeconds);
+
+    return ok ? 0 : 1;
+}
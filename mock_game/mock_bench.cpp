@@ -0,0 +1,408 @@
+// Benchmark of script slowdown with the debugger attached.
+//
+// Runs the workloads in bench/ under several configurations and reports the
+// cost per line cue (one line callback invocation) relative to running
+// without a line callback. Every backend change can be judged against it.
+//
+// Usage:
+//   ./mock_bench.exe [--repeat N] [--steps K] [workload.as...]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asdbg_backend.hpp"
+
+#include "angelscript/angelscript/include/angelscript.h"
+
+#include "angelscript/add_on/scriptarray/scriptarray.h"
+#include "angelscript/add_on/scriptbuilder/scriptbuilder.h"
+#include "angelscript/add_on/scriptdictionary/scriptdictionary.h"
+#include "angelscript/add_on/scriptstdstring/scriptstdstring.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class BenchConfig {
+    NoLineCallback,
+    Detached,
+    LineCallback,
+    Breakpoints10,
+    Breakpoints100,
+    Breakpoints1000,
+    Stepping,
+};
+
+const char *ToString(BenchConfig config) {
+    switch (config) {
+    case BenchConfig::NoLineCallback:
+        return "no-line-callback";
+    case BenchConfig::Detached:
+        return "detached";
+    case BenchConfig::LineCallback:
+        return "line-callback";
+    case BenchConfig::Breakpoints10:
+        return "10-breakpoints";
+    case BenchConfig::Breakpoints100:
+        return "100-breakpoints";
+    case BenchConfig::Breakpoints1000:
+        return "1000-breakpoints";
+    case BenchConfig::Stepping:
+        return "stepping";
+    }
+
+    return "unknown";
+}
+
+int BreakpointCount(BenchConfig config) {
+    switch (config) {
+    case BenchConfig::Breakpoints10:
+        return 10;
+    case BenchConfig::Breakpoints100:
+        return 100;
+    case BenchConfig::Breakpoints1000:
+        return 1000;
+    default:
+        return 0;
+    }
+}
+
+/// @brief Breakpoints in files the workloads never run
+std::vector<asdbg::Breakpoint> UnrelatedBreakpoints(int count) {
+    std::vector<asdbg::Breakpoint> breakpoints;
+    for (int i = 0; i < count; ++i) {
+        breakpoints.push_back(asdbg::Breakpoint{
+            "/bench/unrelated_" + std::to_string(i % 64) + ".as", 1 + i / 64});
+    }
+
+    return breakpoints;
+}
+
+std::atomic<bool> g_running{true};
+
+/// Attached to the in-process responder
+asdbg::AsdbgBackend g_asdbg{};
+
+/// Never started, so contexts attached to it get no line callback
+asdbg::AsdbgBackend g_detachedAsdbg{};
+
+size_t g_lineCues{};
+
+// Interface call cache of the engine, summed over every timed execution
+asQWORD g_interfaceCallHits{};
+asQWORD g_interfaceCallMisses{};
+
+void CountingLineCallback(asIScriptContext *) { g_lineCues++; }
+
+// -----------------------------------------------
+
+/// @brief Minimal in-process adapter. It answers STOP with STEP_IN while
+/// the step budget lasts, then continues. Breakpoints are installed through
+/// AsdbgBackend::SetBreakpoints, so GET_BREAKPOINTS is left unanswered.
+class SteppingResponder {
+  public:
+    /// @return Listening port, or -1 on failure
+    int Listen() {
+        m_server = static_cast<int>(socket(AF_INET, SOCK_STREAM, 0));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = 0;
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        if (bind(m_server, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(m_server, 1) < 0)
+            return -1;
+
+        socklen_t len = sizeof(addr);
+        getsockname(m_server, (sockaddr *)&addr, &len);
+
+        m_thread = std::thread([this]() { Serve(); });
+        return ntohs(addr.sin_port);
+    }
+
+    void Join() {
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void StartStepping(int steps) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_steps = steps;
+        m_stopCount = 0;
+    }
+
+    /// @return Average time from one STOP to the next
+    double NanosecondsPerStep() {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_stopCount < 2)
+            return 0;
+
+        return std::chrono::duration<double, std::nano>(m_lastStop -
+                                                        m_firstStop)
+                   .count() /
+               (m_stopCount - 1);
+    }
+
+  private:
+    int m_server{-1};
+    std::thread m_thread{};
+    std::mutex m_mutex{};
+    int m_steps{};
+    int m_stopCount{};
+    Clock::time_point m_firstStop{};
+    Clock::time_point m_lastStop{};
+
+    void Serve() {
+        const int client = static_cast<int>(accept(m_server, nullptr, nullptr));
+
+        char tmpBuffer[1024];
+        std::string pending;
+        while (true) {
+            const int len = asdbg::simple_socket::receive_data(
+                client, tmpBuffer, sizeof(tmpBuffer));
+            if (len <= 0)
+                break;
+
+            pending.append(tmpBuffer, len);
+
+            size_t newline;
+            while ((newline = pending.find('\n')) != std::string::npos) {
+                const auto line = pending.substr(0, newline);
+                pending.erase(0, newline + 1);
+
+                if (line == "STOP") {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    const auto now = Clock::now();
+                    if (m_stopCount++ == 0)
+                        m_firstStop = now;
+
+                    m_lastStop = now;
+
+                    if (m_stopCount > m_steps) {
+                        Send(client, "COMMAND\nCONTINUE\n");
+                    } else {
+                        Send(client, "COMMAND\nSTEP_IN\n");
+                    }
+                }
+            }
+        }
+
+        asdbg::simple_socket::close_socket(client);
+        asdbg::simple_socket::close_socket(m_server);
+    }
+
+    static void Send(int sock, const std::string &message) {
+        asdbg::simple_socket::send_data(sock, message.c_str(), message.size());
+    }
+};
+
+// -----------------------------------------------
+
+struct Workload {
+    std::string filepath;
+    asIScriptModule *module;
+    size_t lineCues;
+};
+
+double Execute(asIScriptEngine *engine, asIScriptFunction *func,
+               BenchConfig config, asdbg::AsdbgBackend &backend) {
+    asIScriptContext *ctx = engine->CreateContext();
+    if (config != BenchConfig::NoLineCallback)
+        backend.AttachContext(ctx);
+
+    ctx->Prepare(func);
+
+    const auto start = Clock::now();
+    const int result = ctx->Execute();
+    const auto elapsed = Clock::now() - start;
+
+    if (result != asEXECUTION_FINISHED) {
+        std::cerr << "Execution failed: " << result << "\n";
+    }
+
+    asQWORD hits{}, misses{};
+    ctx->GetInterfaceCallCacheStats(&hits, &misses);
+    g_interfaceCallHits += hits;
+    g_interfaceCallMisses += misses;
+
+    backend.DetachContext(ctx);
+    ctx->Release();
+    return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+size_t CountLineCues(asIScriptEngine *engine, asIScriptFunction *func) {
+    asIScriptContext *ctx = engine->CreateContext();
+    ctx->SetLineCallback(asFUNCTION(CountingLineCallback), nullptr,
+                         asCALL_CDECL);
+
+    g_lineCues = 0;
+    ctx->Prepare(func);
+    ctx->Execute();
+    ctx->Release();
+
+    return g_lineCues;
+}
+
+/// @return Nanoseconds per line cue while stepping
+double RunStepping(asIScriptFunction *func, SteppingResponder &responder,
+                   int steps) {
+    // Stop on the first line of main() and step from there
+    const char *section{};
+    int declaredAt{};
+    func->GetDeclaredAt(&section, &declaredAt, nullptr);
+    g_asdbg.SetBreakpoints({asdbg::Breakpoint{section, declaredAt + 1}});
+
+    responder.StartStepping(steps);
+    Execute(func->GetEngine(), func, BenchConfig::Stepping, g_asdbg);
+    return responder.NanosecondsPerStep();
+}
+
+void PrintHistogram(const char *name,
+                    const asdbg::DurationHistogram::Summary &summary) {
+    std::printf("%-22s %10llu samples %10.1f ns/avg %10llu ns/p50 "
+                "%10llu ns/p99\n",
+                name, static_cast<unsigned long long>(summary.count),
+                summary.count ? static_cast<double>(summary.totalNs) /
+                                    summary.count
+                              : 0.0,
+                static_cast<unsigned long long>(summary.p50Ns),
+                static_cast<unsigned long long>(summary.p99Ns));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int repeat = 3;
+    int steps = 20;
+    std::vector<std::string> files{};
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--steps" && i + 1 < argc) {
+            steps = std::max(2, std::atoi(argv[++i]));
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        files = {"bench/fibonacci.as", "bench/arithmetic.as",
+                 "bench/strings.as", "bench/containers.as",
+                 "bench/interfaces.as"};
+    }
+
+    asIScriptEngine *engine = asCreateScriptEngine();
+
+    RegisterStdString(engine);
+    RegisterScriptArray(engine, true);
+    RegisterScriptDictionary(engine);
+
+    std::vector<Workload> workloads{};
+    for (const auto &file : files) {
+        CScriptBuilder builder{};
+        builder.StartNewModule(engine, file.c_str());
+        builder.AddSectionFromFile(file.c_str());
+        if (builder.BuildModule() != asSUCCESS) {
+            std::cerr << "Failed to build " << file << "\n";
+            return 1;
+        }
+
+        workloads.push_back(Workload{file, builder.GetModule(), 0});
+    }
+
+    asdbg::simple_socket::init();
+
+    SteppingResponder responder{};
+    asdbg::transport::TransportOptions transportOptions{};
+    transportOptions.port = responder.Listen();
+    if (transportOptions.port < 0) {
+        std::cerr << "Failed to listen for the stepping responder.\n";
+        return 1;
+    }
+
+    g_asdbg.Start(g_running, transportOptions);
+    while (!g_asdbg.IsAttached()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const BenchConfig configs[] = {
+        BenchConfig::NoLineCallback,  BenchConfig::Detached,
+        BenchConfig::LineCallback,    BenchConfig::Breakpoints10,
+        BenchConfig::Breakpoints100,  BenchConfig::Breakpoints1000,
+        BenchConfig::Stepping,
+    };
+
+    std::printf("%-22s %-18s %12s %10s %14s %8s\n", "workload", "config",
+                "line-cues", "time(ms)", "ns/line-cue", "ratio");
+
+    for (auto &workload : workloads) {
+        asIScriptFunction *func =
+            workload.module->GetFunctionByDecl("void main()");
+        workload.lineCues = CountLineCues(engine, func);
+
+        double baselineNs = 0;
+        for (const auto config : configs) {
+            double nsPerLine;
+            double elapsedMs = 0;
+            if (config == BenchConfig::Stepping) {
+                nsPerLine = RunStepping(func, responder, steps);
+                elapsedMs = nsPerLine * steps / 1e6;
+            } else {
+                g_asdbg.SetBreakpoints(
+                    UnrelatedBreakpoints(BreakpointCount(config)));
+
+                auto &backend = config == BenchConfig::Detached
+                                    ? g_detachedAsdbg
+                                    : g_asdbg;
+
+                double best = 0;
+                for (int i = 0; i < repeat; ++i) {
+                    const double ns = Execute(engine, func, config, backend);
+                    best = i == 0 ? ns : std::min(best, ns);
+                }
+
+                elapsedMs = best / 1e6;
+                nsPerLine = best / std::max<size_t>(1, workload.lineCues);
+            }
+
+            if (config == BenchConfig::NoLineCallback)
+                baselineNs = nsPerLine;
+
+            std::printf("%-22s %-18s %12zu %10.2f %14.1f %8.2f\n",
+                        workload.filepath.c_str(), ToString(config),
+                        workload.lineCues, elapsedMs, nsPerLine,
+                        nsPerLine / baselineNs);
+        }
+    }
+
+    // Where the overhead measured above went, as seen by the backend
+    const auto metrics = g_asdbg.GetMetrics();
+    std::printf("\nbackend: %llu line callbacks, %llu bytes sent, "
+                "%llu bytes received\n",
+                static_cast<unsigned long long>(metrics.lineCallbacks),
+                static_cast<unsigned long long>(metrics.bytesSent),
+                static_cast<unsigned long long>(metrics.bytesReceived));
+    PrintHistogram("find-breakpoint", metrics.findBreakpoint);
+    PrintHistogram("stop-to-resume", metrics.stopToResume);
+    PrintHistogram("variables", metrics.variableSerialization);
+
+    std::printf("\ninterface calls: %llu cache hits, %llu misses\n",
+                static_cast<unsigned long long>(g_interfaceCallHits),
+                static_cast<unsigned long long>(g_interfaceCallMisses));
+
+    g_running = false;
+    g_asdbg.Shutdown();
+    responder.Join();
+
+    engine->ShutDownAndRelease();
+    return 0;
+}
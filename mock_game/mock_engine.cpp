@@ -1,11 +1,10 @@
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <thread>
 
-#include "asdbg_backend.hpp"
-
 #include "angelscript/angelscript/include/angelscript.h"
 
 #include "angelscript/add_on/scriptarray/scriptarray.h"
@@ -13,38 +12,11 @@
 #include "angelscript/add_on/scriptdictionary/scriptdictionary.h"
 #include "angelscript/add_on/scriptstdstring/scriptstdstring.h"
 
+// After scriptarray.h, so that GC censuses account for array elements
+#include "asdbg_backend.hpp"
+
 namespace {
 asdbg::AsdbgBackend g_asdbg{};
-asdbg::DebugCommand g_previousCommand{};
-
-int g_frameCount{};
-
-void LineCallback(asIScriptContext *ctx) {
-    const char *filename{};
-    const auto lineNumber = ctx->GetLineNumber(0, nullptr, &filename);
-
-    std::cout << filename << "\n";
-
-    if (g_previousCommand == asdbg::DebugCommand::StepOver) {
-        const auto filepath = g_asdbg.GetAbsolutePath(filename);
-        g_previousCommand =
-            g_asdbg.TriggerBreakpoint(asdbg::Breakpoint{filepath, lineNumber});
-    }
-
-    if (g_previousCommand == asdbg::DebugCommand::StepIn) {
-        // FIXME: Implement step in (This is same as step over for now)
-        const auto filepath = g_asdbg.GetAbsolutePath(filename);
-        g_previousCommand =
-            g_asdbg.TriggerBreakpoint(asdbg::Breakpoint{filepath, lineNumber});
-    }
-
-    if (const auto bp = g_asdbg.FindBreakpoint(filename, lineNumber)) {
-        std::cout << "Breakpoint hit: " << filename << ", " << lineNumber
-                  << "\n";
-
-        g_previousCommand = g_asdbg.TriggerBreakpoint(*bp);
-    }
-}
 
 void ScriptSleep(int ms) {
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
@@ -54,7 +26,9 @@ void ScriptPrintln(const std::string &msg) { std::cout << msg << std::endl; }
 
 } // namespace
 
-int main() {
+int main(int argc, char **argv) {
+    const char *scriptFile = argc > 1 ? argv[1] : "lazy.as";
+
     std::cout << "Mock engine started!\n"
               << "AngelScript version: " << ANGELSCRIPT_VERSION_STRING
               << std::endl;
@@ -69,30 +43,57 @@ int main() {
                                    asFUNCTION(ScriptPrintln), asCALL_CDECL);
     engine->RegisterGlobalFunction("void sleep(int ms)",
                                    asFUNCTION(ScriptSleep), asCALL_CDECL);
+    g_asdbg.RegisterIntrinsics(engine);
 
     // -----------------------------------------------
 
+    // e.g. ASDBG_TRANSPORT=unix:/tmp/asdbg.sock
+    asdbg::transport::TransportOptions transportOptions{};
+    if (const char *spec = std::getenv("ASDBG_TRANSPORT")) {
+        if (!asdbg::transport::ParseTransportOptions(spec, transportOptions)) {
+            std::cerr << "Invalid ASDBG_TRANSPORT: " << spec << "\n";
+            return 1;
+        }
+    }
+
+    // e.g. ASDBG_SNAPSHOTS=/tmp/game.snap, replayed by snapshot_replay.exe
+    if (const char *path = std::getenv("ASDBG_SNAPSHOTS")) {
+        if (!g_asdbg.EnableSnapshots(path))
+            std::cerr << "Failed to open snapshot file: " << path << "\n";
+    }
+
     std::atomic<bool> running{true};
-    g_asdbg.Start(running);
+    g_asdbg.AttachEngine(engine, "game");
+    g_asdbg.Start(running, transportOptions);
 
     // -----------------------------------------------
 
     CScriptBuilder builder{};
     builder.StartNewModule(engine, "lazy");
-    builder.AddSectionFromFile("lazy.as");
+    builder.AddSectionFromFile(scriptFile);
     if (builder.BuildModule() != asSUCCESS) {
         std::cerr << "Failed to build the script module!\n";
         return 1;
     }
 
+    g_asdbg.IndexModule(builder.GetModule());
+
     asIScriptFunction *scriptMain =
         builder.GetModule()->GetFunctionByDecl("void main()");
     asIScriptContext *ctx = engine->CreateContext();
 
-    ctx->SetLineCallback(asFUNCTION(LineCallback), nullptr, asCALL_CDECL);
+    // The line callback is only installed while the debugger is attached
+    g_asdbg.AttachContext(ctx, "main");
 
     ctx->Prepare(scriptMain);
-    ctx->Execute();
+    if (ctx->Execute() == asEXECUTION_EXCEPTION) {
+        const char *section{};
+        const int line = ctx->GetExceptionLineNumber(nullptr, &section);
+        std::cerr << "Script exception: " << ctx->GetExceptionString() << " ("
+                  << (section ? section : "?") << ", " << line << ")\n";
+    }
+
+    g_asdbg.DetachContext(ctx);
     ctx->Release();
 
     // -----------------------------------------------
@@ -0,0 +1,269 @@
+// Feeds a snapshot file written by AsdbgBackend::EnableSnapshots back to the
+// VSCode debug adapter, as if the engine that recorded it were attached live.
+//
+// Each snapshot becomes a STOP or EXCEPTION with the variables of the top
+// frame and the recorded globals. The next snapshot is sent once the debugger
+// continues or steps, so a recorded session can be walked through stop by
+// stop. Nothing can be evaluated or changed; the stacks below the top frame
+// are listed with the exception stops only.
+//
+// Usage:
+//   ./snapshot_replay.exe game.snap
+//
+// The adapter is reached the way the backend reaches it, through the
+// ASDBG_TRANSPORT environment variable. POSIX only.
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "asdbg_backend.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using asdbg::Snapshot;
+using asdbg::SnapshotKind;
+using asdbg::transport::ITransport;
+
+/// @brief Line-oriented reader over a transport, like the one in
+/// mock_adapter.cpp
+class LineReader {
+  public:
+    explicit LineReader(ITransport &transport) : m_transport(transport) {}
+
+    /// @param timeoutMs negative to wait for as long as the adapter lives
+    /// @return false on timeout or disconnect
+    bool ReadLine(std::string &line, int timeoutMs) {
+        const auto deadline =
+            Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while (true) {
+            const auto newline = m_buffer.find('\n', m_pos);
+            if (newline != std::string::npos) {
+                line.assign(m_buffer, m_pos, newline - m_pos);
+                m_pos = newline + 1;
+                if (m_pos == m_buffer.size()) {
+                    m_buffer.clear();
+                    m_pos = 0;
+                }
+
+                return true;
+            }
+
+            // Poll in slices while waiting indefinitely, as not every
+            // transport takes a negative timeout
+            int waitMs = 1000;
+            if (timeoutMs >= 0) {
+                const auto remaining =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - Clock::now())
+                        .count();
+                if (remaining <= 0)
+                    return false;
+
+                waitMs = static_cast<int>(remaining);
+            }
+
+            if (!m_transport.WaitReadable(waitMs)) {
+                if (timeoutMs < 0)
+                    continue;
+
+                return false;
+            }
+
+            char tmpBuffer[4096];
+            const auto len = m_transport.Receive(tmpBuffer, sizeof(tmpBuffer));
+            if (len <= 0)
+                return false;
+
+            m_buffer.append(tmpBuffer, len);
+        }
+    }
+
+  private:
+    ITransport &m_transport;
+    std::string m_buffer{};
+    size_t m_pos{};
+};
+
+// -----------------------------------------------
+
+class Replay {
+  public:
+    explicit Replay(ITransport &transport)
+        : m_transport(transport), m_reader(transport) {}
+
+    void Begin() {
+        // The adapter answers with the breakpoints, whose paths are the only
+        // absolute ones it knows
+        Send("GET_BREAKPOINTS\n");
+        std::string line{};
+        if (m_reader.ReadLine(line, 5000) && line == "BREAKPOINTS") {
+            while (m_reader.ReadLine(line, 5000) && line != "END_BREAKPOINTS")
+                m_filepaths.push_back(line.substr(0, line.rfind(',')));
+        }
+
+        Send("THREADS\n0\n");
+    }
+
+    /// @brief Send one snapshot and wait until the debugger resumes it
+    /// @return false if the adapter went away
+    bool Play(const Snapshot &snapshot) {
+        if (m_engines.insert(snapshot.engineId).second) {
+            Send("ENGINE\n" + std::to_string(snapshot.engineId) + "\nengine " +
+                 std::to_string(snapshot.engineId) + "\n");
+        }
+
+        const std::string threadId = std::to_string(snapshot.threadId);
+        if (m_threads.insert(snapshot.threadId).second) {
+            Send("THREAD_STARTED\n" + threadId + "\n" + snapshot.threadName +
+                 "\n" + std::to_string(snapshot.engineId) + "\n");
+        }
+
+        if (snapshot.frames.empty())
+            return true;
+
+        const auto &top = snapshot.frames.front();
+        std::string message{};
+        message += snapshot.kind == SnapshotKind::Exception ? "EXCEPTION\n"
+                                                            : "STOP\n";
+        message += threadId + "\n";
+        message += Location(top) + "\n";
+        message += std::to_string(snapshot.engineId) + ":" + snapshot.module +
+                   "\n";
+        if (snapshot.kind == SnapshotKind::Exception) {
+            asdbg::detail::AppendEscaped(message, snapshot.description);
+            message += "\n";
+            message += snapshot.caught ? "1\n" : "0\n";
+            message += std::to_string(snapshot.frames.size()) + "\n";
+            for (const auto &frame : snapshot.frames) {
+                message += frame.declaration + "\n";
+                message += Location(frame) + "\n";
+            }
+        }
+
+        // The frame key only has to differ between frames, which the reset
+        // flag makes moot
+        message += "VARIABLES_DELTA\n";
+        message += threadId + ":" + std::to_string(snapshot.frames.size()) +
+                   ":0\n1\n";
+        message += std::to_string(top.variables.size() +
+                                  snapshot.globals.size()) +
+                   "\n";
+        for (const auto &var : top.variables) {
+            message += var.name + "\n" + var.value + "\n";
+        }
+
+        for (const auto &var : snapshot.globals) {
+            message += "::" + var.name + "\n" + var.value + "\n";
+        }
+
+        message += "0\n";
+        Send(message);
+        return WaitResume();
+    }
+
+    void End() {
+        for (const int threadId : m_threads)
+            Send("THREAD_EXITED\n" + std::to_string(threadId) + "\n");
+    }
+
+  private:
+    ITransport &m_transport;
+    LineReader m_reader;
+    std::vector<std::string> m_filepaths{};
+    std::set<int> m_engines{};
+    std::set<int> m_threads{};
+
+    void Send(const std::string &message) {
+        m_transport.Send(message.data(), message.size());
+    }
+
+    /// @brief "filepath,line", resolved against the breakpoint paths like
+    /// AsdbgBackend::GetAbsolutePath
+    std::string Location(const asdbg::SnapshotFrame &frame) const {
+        std::string filepath = frame.section;
+        for (const auto &path : m_filepaths) {
+            if (asdbg::detail::EndWith(path, frame.section)) {
+                filepath = path;
+                break;
+            }
+        }
+
+        return filepath + "," + std::to_string(frame.line);
+    }
+
+    /// @brief Skip everything but the next command. Whatever it asks for, the
+    /// recording goes on with the next snapshot.
+    bool WaitResume() {
+        std::string line{};
+        while (m_reader.ReadLine(line, -1)) {
+            if (line != "COMMAND")
+                continue;
+
+            // COMMAND\n[thread id\n]command
+            if (!m_reader.ReadLine(line, 5000))
+                return false;
+
+            const bool hasThreadId =
+                !line.empty() &&
+                std::isdigit(static_cast<unsigned char>(line[0]));
+            return !hasThreadId || m_reader.ReadLine(line, 5000);
+        }
+
+        return false;
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <snapshot file>\n";
+        return 1;
+    }
+
+    asdbg::SnapshotReader reader{};
+    if (!reader.Open(argv[1])) {
+        std::cerr << "Not a snapshot file: " << argv[1] << "\n";
+        return 1;
+    }
+
+    asdbg::transport::TransportOptions transportOptions{};
+    if (const char *spec = std::getenv("ASDBG_TRANSPORT")) {
+        if (!asdbg::transport::ParseTransportOptions(spec, transportOptions)) {
+            std::cerr << "Invalid ASDBG_TRANSPORT: " << spec << "\n";
+            return 1;
+        }
+    }
+
+    const auto transport = asdbg::transport::Connect(transportOptions);
+    if (!transport) {
+        std::cerr << "Failed to connect to the debugger.\n";
+        return 1;
+    }
+
+    Replay replay{*transport};
+    replay.Begin();
+
+    Snapshot snapshot{};
+    int played{};
+    while (reader.Next(snapshot)) {
+        if (!replay.Play(snapshot)) {
+            std::cerr << "Debugger disconnected.\n";
+            return 1;
+        }
+
+        played++;
+    }
+
+    replay.End();
+    std::printf("Replayed %d snapshots.\n", played);
+    return 0;
+}
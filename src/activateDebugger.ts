@@ -34,6 +34,24 @@ export function activateDebugger(context: vscode.ExtensionContext) {
     //     });
     // }));
 
+    context.subscriptions.push(
+        vscode.commands.registerCommand('asdbg-vscode.gcCensus', () => {
+            const ds = vscode.debug.activeDebugSession;
+            if (ds) {
+                ds.customRequest('gcCensus');
+            }
+        })
+    );
+
+    context.subscriptions.push(
+        vscode.commands.registerCommand('asdbg-vscode.showMetrics', () => {
+            const ds = vscode.debug.activeDebugSession;
+            if (ds) {
+                ds.customRequest('showMetrics');
+            }
+        })
+    );
+
     // register a configuration provider for 'asdbg' debug type
     const provider = new AsdbgConfigurationProvider();
     context.subscriptions.push(vscode.debug.registerDebugConfigurationProvider('asdbg', provider));
@@ -1,13 +1,17 @@
 import {
+    BreakpointEvent,
     InitializedEvent,
     LoggingDebugSession,
+    OutputEvent,
     StoppedEvent,
-    Thread
+    Thread,
+    ThreadEvent
 } from "@vscode/debugadapter";
 import { DebugProtocol } from "@vscode/debugprotocol";
 import * as net from 'net';
 
-const mainThreadId = 1;
+// Stack frame ids are `threadId * frameIdsPerThread + level`
+const frameIdsPerThread = 1000;
 
 interface ScriptBreakpoint {
     filepath: string;
@@ -19,15 +23,67 @@ interface ScriptVariable {
     value: string;
 }
 
+interface ScriptStackFrame {
+    name: string;
+    filepath: string;
+    line: number;
+}
+
+interface ScriptException {
+    description: string;
+    caught: boolean;
+    stack: ScriptStackFrame[];
+}
+
+// A script context, shown as a thread
+interface ScriptThread {
+    name: string;
+    engineId: number;
+}
+
+// Where a script thread (context) is stopped
+interface ThreadStop {
+    breakpoint: ScriptBreakpoint;
+    // Module of the function stopped in
+    module: string;
+    // Set when stopped on an exception
+    exception: ScriptException | undefined;
+    variables: ScriptVariable[];
+}
+
 export class AsdbgSession extends LoggingDebugSession {
     // Breakpoints are stored per file path as an array
     public breakpoints: Map<string, DebugProtocol.SourceBreakpoint[]> = new Map();
 
+    // Ids of the breakpoints in `breakpoints`, by file path, so the backend can move them
+    private readonly _breakpointIds: Map<string, number[]> = new Map();
+
+    private _nextBreakpointId = 1;
+
+    // Pending breakpointLocationsRequest queries, by request id
+    private readonly _breakpointLocations: Map<number, (lines: number[]) => void> = new Map();
+
+    private _nextBreakpointLocationsId = 1;
+
+    // Overhead of the backend as last pushed in a METRICS message, formatted for the debug console
+    private _lastMetrics = '';
+
     private readonly _clients: net.Socket[] = [];
 
-    private _currentBreakpoint: ScriptBreakpoint | undefined;
+    // Name of each script thread, by thread id
+    private readonly _threads: Map<number, ScriptThread> = new Map();
+
+    // Name of each script engine, by engine id
+    private readonly _engines: Map<number, string> = new Map();
 
-    private readonly _variables: ScriptVariable[] = [];
+    // Stopped threads, by thread id
+    private readonly _stops: Map<number, ThreadStop> = new Map();
+
+    // One of 'none', 'uncaught' or 'all'
+    private _exceptionFilter = 'uncaught';
+
+    // Variables of each frame as last received, which VARIABLES_DELTA messages apply to
+    private readonly _frameVariables: Map<string, Map<string, string>> = new Map();
 
     public constructor(fileAccessor: any) {
         super('angel-debug.txt', fileAccessor);
@@ -82,6 +138,21 @@ export class AsdbgSession extends LoggingDebugSession {
         // Support delayed loading of stack traces (load only when needed)
         response.body.supportsDelayedStackTraceLoading = true;
 
+        // Stop on script exceptions
+        response.body.exceptionBreakpointFilters = [
+            {
+                filter: 'uncaught',
+                label: 'Uncaught Exceptions',
+                default: true
+            },
+            {
+                filter: 'all',
+                label: 'All Exceptions',
+                default: false
+            }
+        ];
+        response.body.supportsExceptionInfoRequest = true;
+
         // Redundant assignments (safe to keep or remove)
         response.body.supportSuspendDebuggee = true;
         response.body.supportTerminateDebuggee = true;
@@ -97,17 +168,40 @@ export class AsdbgSession extends LoggingDebugSession {
             this._clients.push(socket);
             console.log('Client connected');
 
-            // When data is received from the client
+            // When data is received from the client.
+            // A message may be split across chunks, so the incomplete rest is kept for the next one.
+            let pending = '';
             socket.on('data', (data: Buffer) => {
-                const messages = data.toString().split('\n');
+                pending += data.toString();
+                const lastNewline = pending.lastIndexOf('\n');
+                if (lastNewline === -1) {
+                    return;
+                }
+
+                let messages = pending.substring(0, lastNewline).split('\n');
+                pending = pending.substring(lastNewline + 1);
                 while (messages.length > 0) {
-                    this.handleSocketData(socket, messages);
+                    const rest = messages.slice();
+                    if (!this.handleSocketData(socket, rest)) {
+                        pending = messages.join('\n') + '\n' + pending;
+                        break;
+                    }
+
+                    messages = rest;
                 }
             });
 
             socket.on('end', () => {
                 console.log('Client disconnected');
 
+                for (const threadId of this._threads.keys()) {
+                    this.sendEvent(new ThreadEvent('exited', threadId));
+                }
+
+                this._threads.clear();
+                this._engines.clear();
+                this._stops.clear();
+
                 // Remove disconnected socket from the array
                 const index = this._clients.indexOf(socket);
                 if (index !== -1) {
@@ -123,36 +217,374 @@ export class AsdbgSession extends LoggingDebugSession {
         console.log('Debug adapter initialized!');
     }
 
-    private handleSocketData(socket: net.Socket, messages: string[]) {
+    // Returns false if the message is incomplete, in which case `messages` is left in an unspecified state
+    private handleSocketData(socket: net.Socket, messages: string[]): boolean {
         const method = messages.shift();
         if (method === undefined || method === '') {
-            return;
+            return true;
         }
         else if (method === 'GET_BREAKPOINTS') {
             // Send breakpoints to the client
             this.sendBreakpoints(socket);
+            this.sendExceptionBreakpoints(socket);
+        } else if (method === 'BREAKPOINTS_RESOLVED') {
+            // Breakpoints moved to the next line with code, or dropped (resolved line 0).
+            // ```
+            // BREAKPOINTS_RESOLVED
+            // 1 (breakpoints)
+            // filepath,3 (requested line),4 (resolved line)
+            // ```
+            const countLine = messages.shift();
+            if (countLine === undefined) {
+                return false;
+            }
+
+            const resolved: [string, number, number][] = [];
+            for (let i = 0; i < parseInt(countLine, 10); i++) {
+                const entry = messages.shift();
+                if (entry === undefined) {
+                    return false;
+                }
+
+                const lineSeparator = entry.lastIndexOf(',');
+                const requestedSeparator = entry.lastIndexOf(',', lineSeparator - 1);
+                resolved.push([
+                    entry.substring(0, requestedSeparator),
+                    parseInt(entry.substring(requestedSeparator + 1, lineSeparator), 10),
+                    parseInt(entry.substring(lineSeparator + 1), 10)
+                ]);
+            }
+
+            for (const [filepath, requestedLine, line] of resolved) {
+                const bps = this.breakpoints.get(filepath) ?? [];
+                const ids = this._breakpointIds.get(filepath) ?? [];
+                bps.forEach((bp, index) => {
+                    if (bp.line === requestedLine && ids[index] !== undefined) {
+                        this.sendEvent(new BreakpointEvent('changed', {
+                            id: ids[index],
+                            verified: line > 0,
+                            line: line > 0 ? line : requestedLine
+                        }));
+                    }
+                });
+            }
+        } else if (method === 'BREAKPOINT_LOCATIONS') {
+            // ```
+            // BREAKPOINT_LOCATIONS
+            // 1 (request id)
+            // 2 (lines)
+            // 4
+            // 8
+            // ```
+            const requestId = messages.shift();
+            const countLine = messages.shift();
+            if (requestId === undefined || countLine === undefined) {
+                return false;
+            }
+
+            const lines: number[] = [];
+            for (let i = 0; i < parseInt(countLine, 10); i++) {
+                const line = messages.shift();
+                if (line === undefined) {
+                    return false;
+                }
+
+                lines.push(parseInt(line, 10));
+            }
+
+            const resolve = this._breakpointLocations.get(parseInt(requestId, 10));
+            this._breakpointLocations.delete(parseInt(requestId, 10));
+            resolve?.(lines);
+        } else if (method === 'METRICS') {
+            // Pushed periodically by the backend.
+            // ```
+            // METRICS
+            // 3000995 (line callbacks)
+            // 2096 (bytes sent)
+            // 337 (bytes received)
+            // 1 (histograms)
+            // stop_to_resume
+            // 21 (samples)
+            // 388506 (total ns)
+            // 55211 (max ns)
+            // 16383 (p50 ns)
+            // 55211 (p99 ns)
+            // 1 (message types)
+            // sent:STOP
+            // 21 (messages)
+            // ```
+            const header = messages.splice(0, 4);
+            if (header.length < 4) {
+                return false;
+            }
+
+            const [lineCallbacks, bytesSent, bytesReceived, histogramCount] = header;
+            let report = `Debugger overhead: ${lineCallbacks} line callbacks, ` +
+                `${bytesSent} bytes sent, ${bytesReceived} bytes received\n`;
+            report += 'histogram\tsamples\ttotal ns\tmax ns\tp50 ns\tp99 ns\n';
+            for (let i = 0; i < parseInt(histogramCount, 10); i++) {
+                const fields = messages.splice(0, 6);
+                if (fields.length < 6) {
+                    return false;
+                }
+
+                report += fields.join('\t') + '\n';
+            }
+
+            const typeCount = messages.shift();
+            if (typeCount === undefined) {
+                return false;
+            }
+
+            report += 'message\tcount\n';
+            for (let i = 0; i < parseInt(typeCount, 10); i++) {
+                const fields = messages.splice(0, 2);
+                if (fields.length < 2) {
+                    return false;
+                }
+
+                report += fields.join('\t') + '\n';
+            }
+
+            this._lastMetrics = report;
+        } else if (method === 'GC_CENSUS_PROGRESS') {
+            const visited = messages.shift();
+            const total = messages.shift();
+            if (visited === undefined || total === undefined) {
+                return false;
+            }
+
+            this.sendEvent(new OutputEvent(`GC census: ${visited} / ${total} objects\n`, 'console'));
+        } else if (method === 'GC_CENSUS') {
+            // ```
+            // GC_CENSUS
+            // 3001 (objects visited)
+            // 3001 (objects currently in the GC)
+            // 0 (objects destroyed so far)
+            // 0 (garbage detected so far)
+            // 1 (types)
+            // Node
+            // 3000 (objects)
+            // 144000 (approximate bytes)
+            // 4 (objects in the new generation)
+            // 2996 (objects in the old generation)
+            // 1 (largest arrays)
+            // Node@[]
+            // 3000 (length)
+            // 24040 (approximate bytes)
+            // ```
+            const header: string[] = [];
+            for (let i = 0; i < 5; i++) {
+                const line = messages.shift();
+                if (line === undefined) {
+                    return false;
+                }
+
+                header.push(line);
+            }
+
+            const [visited, currentSize, totalDestroyed, totalDetected, typeCount] = header;
+            let report = `GC census: ${visited} objects visited, ${currentSize} in the GC, ` +
+                `${totalDestroyed} destroyed, ${totalDetected} garbage detected\n`;
+            report += 'type\tobjects\tbytes\tnew\told\n';
+            for (let i = 0; i < parseInt(typeCount, 10); i++) {
+                const fields = messages.splice(0, 5);
+                if (fields.length < 5) {
+                    return false;
+                }
+
+                report += fields.join('\t') + '\n';
+            }
+
+            const arrayCount = messages.shift();
+            if (arrayCount === undefined) {
+                return false;
+            }
+
+            report += 'largest arrays\tlength\tbytes\n';
+            for (let i = 0; i < parseInt(arrayCount, 10); i++) {
+                const fields = messages.splice(0, 3);
+                if (fields.length < 3) {
+                    return false;
+                }
+
+                report += fields.join('\t') + '\n';
+            }
+
+            this.sendEvent(new OutputEvent(report, 'console'));
+        } else if (method === 'THREADS') {
+            // ```
+            // THREADS
+            // 1 (threads)
+            // 1 (thread id)
+            // main
+            // 1 (engine id)
+            // ```
+            const countLine = messages.shift();
+            if (countLine === undefined) {
+                return false;
+            }
+
+            const threads: Map<number, ScriptThread> = new Map();
+            for (let i = 0; i < parseInt(countLine, 10); i++) {
+                const threadId = messages.shift();
+                const name = messages.shift();
+                const engineId = messages.shift();
+                if (threadId === undefined || name === undefined || engineId === undefined) {
+                    return false;
+                }
+
+                threads.set(parseInt(threadId, 10), { name: name, engineId: parseInt(engineId, 10) });
+            }
+
+            this._threads.clear();
+            this._stops.clear();
+            for (const [threadId, thread] of threads.entries()) {
+                this._threads.set(threadId, thread);
+                this.sendEvent(new ThreadEvent('started', threadId));
+            }
+        } else if (method === 'THREAD_STARTED') {
+            const threadId = messages.shift();
+            const name = messages.shift();
+            const engineId = messages.shift();
+            if (threadId === undefined || name === undefined || engineId === undefined) {
+                return false;
+            }
+
+            this._threads.set(parseInt(threadId, 10), { name: name, engineId: parseInt(engineId, 10) });
+            this.sendEvent(new ThreadEvent('started', parseInt(threadId, 10)));
+        } else if (method === 'ENGINE') {
+            // Sent for each engine before THREADS, and when an engine is named later
+            const engineId = messages.shift();
+            const name = messages.shift();
+            if (engineId === undefined || name === undefined) {
+                return false;
+            }
+
+            this._engines.set(parseInt(engineId, 10), name);
+        } else if (method === 'THREAD_EXITED') {
+            const threadId = messages.shift();
+            if (threadId === undefined) {
+                return false;
+            }
+
+            this._threads.delete(parseInt(threadId, 10));
+            this._stops.delete(parseInt(threadId, 10));
+            this.sendEvent(new ThreadEvent('exited', parseInt(threadId, 10)));
+        } else if (method === 'TRACE') {
+            // trace() called by the script
+            // ```
+            // TRACE
+            // 1 (thread id)
+            // filepath,line
+            // message
+            // ```
+            const threadId = messages.shift();
+            const location = messages.shift();
+            const message = messages.shift();
+            if (threadId === undefined || location === undefined || message === undefined) {
+                return false;
+            }
+
+            const separator = location.lastIndexOf(',');
+            const filepath = location.substring(0, separator);
+            const event: DebugProtocol.OutputEvent = new OutputEvent(message + '\n', 'stdout');
+            event.body.source = { name: filepath, path: filepath };
+            event.body.line = parseInt(location.substring(separator + 1), 10);
+            this.sendEvent(event);
         } else if (method === 'STOP') {
             // ```
             // STOP
+            // 1 (thread id)
             // filepath,line
+            // 1:module (engine id and module)
             // ```
+            const threadId = messages.shift();
             const nextMessage = messages.shift();
+            const moduleTag = messages.shift();
+            if (threadId === undefined || nextMessage === undefined || moduleTag === undefined) {
+                return false;
+            }
+
             const [filepath, line] = nextMessage ? nextMessage.split(',') : [undefined, undefined];
             const lineNumber = line !== undefined ? parseInt(line, 10) : undefined;
             if (filepath === undefined || lineNumber === undefined) {
                 console.log('Invalid STOP message received.');
-                return;
+                return true;
             }
 
-            this._currentBreakpoint = {
-                filepath: filepath,
-                line: lineNumber
-            };
+            this._stops.set(parseInt(threadId, 10), {
+                breakpoint: {
+                    filepath: filepath,
+                    line: lineNumber
+                },
+                module: moduleTag.substring(moduleTag.indexOf(':') + 1),
+                exception: undefined,
+                variables: []
+            });
 
             // Send message for VSCode to stop at the breakpoint
-            this.sendEvent(new StoppedEvent('breakpoint', mainThreadId));
+            this.sendEvent(new StoppedEvent('breakpoint', parseInt(threadId, 10)));
+        }
+        else if (method === 'EXCEPTION') {
+            // ```
+            // EXCEPTION
+            // 1 (thread id)
+            // filepath,line
+            // 1:module (engine id and module)
+            // description
+            // 0 (1 if a try/catch will catch it)
+            // 2 (stack frames)
+            // void inner(int)
+            // filepath,line
+            // void main()
+            // filepath,line
+            // ```
+            const threadId = messages.shift();
+            const location = messages.shift();
+            const moduleTag = messages.shift();
+            const description = messages.shift();
+            const caught = messages.shift();
+            const frameCount = messages.shift();
+            if (threadId === undefined || location === undefined || moduleTag === undefined || description === undefined || caught === undefined || frameCount === undefined) {
+                return false;
+            }
+
+            const stack: ScriptStackFrame[] = [];
+            for (let i = 0; i < parseInt(frameCount, 10); i++) {
+                const name = messages.shift();
+                const frameLocation = messages.shift();
+                if (name === undefined || frameLocation === undefined) {
+                    return false;
+                }
+
+                const separator = frameLocation.lastIndexOf(',');
+                stack.push({
+                    name: name,
+                    filepath: frameLocation.substring(0, separator),
+                    line: parseInt(frameLocation.substring(separator + 1), 10)
+                });
+            }
+
+            const separator = location.lastIndexOf(',');
+            this._stops.set(parseInt(threadId, 10), {
+                breakpoint: {
+                    filepath: location.substring(0, separator),
+                    line: parseInt(location.substring(separator + 1), 10)
+                },
+                module: moduleTag.substring(moduleTag.indexOf(':') + 1),
+                exception: {
+                    description: description,
+                    caught: caught === '1',
+                    stack: stack
+                },
+                variables: []
+            });
+
+            this.sendEvent(new StoppedEvent('exception', parseInt(threadId, 10), description));
         }
         else if (method === 'VARIABLES') {
+            // Variables of the last stopped thread.
             // ```
             // VARIABLES
             // 2
@@ -161,24 +593,102 @@ export class AsdbgSession extends LoggingDebugSession {
             // variable_name_2
             // 456
             // ```
-            this._variables.length = 0; // clear
-            const count = parseInt(messages.shift() ?? '0', 10);
+            const countLine = messages.shift();
+            if (countLine === undefined) {
+                return false;
+            }
+
+            const count = parseInt(countLine, 10);
+            const variables: ScriptVariable[] = [];
             for (let i = 0; i < count; i++) {
                 const name = messages.shift();
                 const value = messages.shift();
                 if (name === undefined || value === undefined) {
-                    console.log('Invalid VARIABLES message received.');
-                    break;
+                    return false;
                 }
 
-                this._variables.push({
+                variables.push({
                     name: name,
                     value: value
                 });
             }
+
+            const stop = Array.from(this._stops.values()).pop();
+            if (stop !== undefined) {
+                stop.variables = variables;
+            }
+        }
+        else if (method === 'VARIABLES_DELTA') {
+            // Only the variables that differ from the previous stop in the same frame.
+            // ```
+            // VARIABLES_DELTA
+            // frame_key (thread_id:depth:function_id)
+            // 0 (1 to drop the variables kept for the frame first)
+            // 1 (added or changed)
+            // variable_name_1
+            // 123
+            // 1 (removed)
+            // variable_name_2
+            // ```
+            const frameKey = messages.shift();
+            const reset = messages.shift();
+            const changedCount = messages.shift();
+            if (frameKey === undefined || reset === undefined || changedCount === undefined) {
+                return false;
+            }
+
+            const changed: ScriptVariable[] = [];
+            for (let i = 0; i < parseInt(changedCount, 10); i++) {
+                const name = messages.shift();
+                const value = messages.shift();
+                if (name === undefined || value === undefined) {
+                    return false;
+                }
+
+                changed.push({ name: name, value: value });
+            }
+
+            const removedCount = messages.shift();
+            if (removedCount === undefined) {
+                return false;
+            }
+
+            const removed: string[] = [];
+            for (let i = 0; i < parseInt(removedCount, 10); i++) {
+                const name = messages.shift();
+                if (name === undefined) {
+                    return false;
+                }
+
+                removed.push(name);
+            }
+
+            let frame = this._frameVariables.get(frameKey);
+            if (frame === undefined || reset === '1') {
+                frame = new Map();
+                this._frameVariables.set(frameKey, frame);
+            }
+
+            for (const v of changed) {
+                frame.set(v.name, v.value);
+            }
+
+            for (const name of removed) {
+                frame.delete(name);
+            }
+
+            // VSCode highlights the values that differ from the previous stop
+            const stop = this._stops.get(parseInt(frameKey.split(':')[0], 10));
+            if (stop !== undefined) {
+                stop.variables = Array.from(frame.entries()).map(([name, value]) => {
+                    return { name: name, value: value };
+                });
+            }
         } else {
             console.log('Unknown message received: ' + method);
         }
+
+        return true;
     }
 
     // Send breakpoint information to the C++ client
@@ -196,6 +706,42 @@ export class AsdbgSession extends LoggingDebugSession {
         console.log('Sent breakpoints to client:\n' + message);
     }
 
+    private sendExceptionBreakpoints(socket: net.Socket): void {
+        socket.write(`EXCEPTION_BREAKPOINTS\n${this._exceptionFilter}\n`);
+    }
+
+    protected setExceptionBreakPointsRequest(response: DebugProtocol.SetExceptionBreakpointsResponse, args: DebugProtocol.SetExceptionBreakpointsArguments): void {
+        // 'all' includes the uncaught ones
+        if (args.filters.includes('all')) {
+            this._exceptionFilter = 'all';
+        } else if (args.filters.includes('uncaught')) {
+            this._exceptionFilter = 'uncaught';
+        } else {
+            this._exceptionFilter = 'none';
+        }
+
+        for (const socket of this._clients) {
+            this.sendExceptionBreakpoints(socket);
+        }
+
+        this.sendResponse(response);
+    }
+
+    protected exceptionInfoRequest(response: DebugProtocol.ExceptionInfoResponse, args: DebugProtocol.ExceptionInfoArguments): void {
+        const exception = this._stops.get(args.threadId)?.exception;
+        response.body = {
+            exceptionId: 'ScriptException',
+            description: exception?.description ?? '',
+            breakMode: exception?.caught === false ? 'unhandled' : 'always',
+            details: {
+                message: exception?.description,
+                stackTrace: exception?.stack.map(frame => `${frame.name} (${frame.filepath}:${frame.line})`).join('\n')
+            }
+        };
+
+        this.sendResponse(response);
+    }
+
     protected attachRequest(response: DebugProtocol.AttachResponse, args: DebugProtocol.AttachRequestArguments, request?: DebugProtocol.Request) {
         super.attachRequest(response, args, request);
         this.sendResponse(response);
@@ -207,12 +753,21 @@ export class AsdbgSession extends LoggingDebugSession {
         }
 
         console.log('Set breakpoints request received.');
-        super.setBreakPointsRequest(response, args, request);
 
+        const bps = args.breakpoints ?? [];
+        const ids = bps.map(() => this._nextBreakpointId++);
         if (args.source.path !== undefined && args.breakpoints !== undefined) {
             this.breakpoints.set(args.source.path, args.breakpoints);
+            this._breakpointIds.set(args.source.path, ids);
         }
 
+        // The backend moves them to the next line with code once the script is built (BREAKPOINTS_RESOLVED)
+        response.body = {
+            breakpoints: bps.map((bp, index) => {
+                return { id: ids[index], verified: true, line: bp.line };
+            })
+        };
+
         // Send breakpoint updates to all connected clients
         for (const socket of this._clients) {
             this.sendBreakpoints(socket);
@@ -222,35 +777,76 @@ export class AsdbgSession extends LoggingDebugSession {
     }
 
     protected threadsRequest(response: DebugProtocol.ThreadsResponse): void {
-        response.body = { threads: [new Thread(mainThreadId, "Thread")] };
+        response.body = {
+            threads: Array.from(this._threads.entries()).map(([threadId, thread]) => {
+                // Threads of several engines are told apart by the engine name
+                const engineName = this._engines.get(thread.engineId) ?? '';
+                return new Thread(threadId, engineName !== '' ? `${engineName}: ${thread.name}` : thread.name);
+            })
+        };
         this.sendResponse(response);
     }
 
-    // protected breakpointLocationsRequest(response: DebugProtocol.BreakpointLocationsResponse, args: DebugProtocol.BreakpointLocationsArguments, request?: DebugProtocol.Request): void {
-    //     // このファイル内でブレイクポイントを設定できる箇所
-    //     response.body = {
-    //         breakpoints: [
-    //             {
-    //                 line: 4,
-    //                 column: 1,
-    //                 endLine: 4,
-    //                 endColumn: 1
-    //             }
-    //         ]
-    //     };
-
-    //     this.sendResponse(response);
-    // }
+    // Lines with code in the requested range, as indexed by the backend
+    protected async breakpointLocationsRequest(response: DebugProtocol.BreakpointLocationsResponse, args: DebugProtocol.BreakpointLocationsArguments, request?: DebugProtocol.Request) {
+        const socket = this._clients[0];
+        let lines: number[] = [];
+        if (args.source.path !== undefined && socket !== undefined) {
+            const requestId = this._nextBreakpointLocationsId++;
+            lines = await new Promise<number[]>(resolve => {
+                this._breakpointLocations.set(requestId, resolve);
+                socket.write(`BREAKPOINT_LOCATIONS\n${requestId}\n${args.source.path}\n${args.line}\n${args.endLine ?? args.line}\n`);
+
+                // Give up if the backend does not answer, e.g. when it disconnects
+                setTimeout(() => {
+                    if (this._breakpointLocations.delete(requestId)) {
+                        resolve([]);
+                    }
+                }, 1000);
+            });
+        }
+
+        response.body = {
+            breakpoints: lines.map(line => {
+                return { line: line };
+            })
+        };
+
+        this.sendResponse(response);
+    }
 
     // This event function is called when VSCode requests a stack trace
     protected async stackTraceRequest(response: DebugProtocol.StackTraceResponse, args: DebugProtocol.StackTraceArguments, request?: DebugProtocol.Request) {
-        const filepath = this._currentBreakpoint?.filepath ?? 'unknown';
+        const stop = this._stops.get(args.threadId);
+
+        // The whole stack is only known for exceptions
+        if (stop?.exception !== undefined) {
+            response.body = {
+                stackFrames: stop.exception.stack.map((frame, i) => {
+                    return {
+                        id: args.threadId * frameIdsPerThread + i,
+                        name: frame.name,
+                        line: frame.line,
+                        column: 1,
+                        source: {
+                            name: frame.filepath,
+                            path: frame.filepath
+                        }
+                    };
+                })
+            };
+
+            this.sendResponse(response);
+            return;
+        }
+
+        const filepath = stop?.breakpoint.filepath ?? 'unknown';
         response.body = {
             stackFrames: [
                 {
-                    id: 1,
-                    name: filepath,
-                    line: this._currentBreakpoint?.line ?? 0,
+                    id: args.threadId * frameIdsPerThread,
+                    name: stop?.module ? `${stop.module}: ${filepath}` : filepath,
+                    line: stop?.breakpoint.line ?? 0,
                     column: 1,
                     source: {
                         name: filepath,
@@ -264,54 +860,82 @@ export class AsdbgSession extends LoggingDebugSession {
     }
 
     protected nextRequest(response: DebugProtocol.NextResponse, args: DebugProtocol.NextArguments): void {
-        this._clients.forEach(client => {
-            client.write('COMMAND\nSTEP_OVER\n');
-        });
+        this.sendCommand(args.threadId, 'STEP_OVER');
 
         this.sendResponse(response);
     }
 
     protected stepInRequest(response: DebugProtocol.StepInResponse, args: DebugProtocol.StepInArguments): void {
-        this._clients.forEach(client => {
-            client.write('COMMAND\nSTEP_IN\n');
-        });
+        this.sendCommand(args.threadId, 'STEP_IN');
 
         this.sendResponse(response);
     }
 
     protected continueRequest(response: DebugProtocol.ContinueResponse, args: DebugProtocol.ContinueArguments): void {
-        this._clients.forEach(client => {
-            client.write('COMMAND\nCONTINUE\n');
-        });
+        this.sendCommand(args.threadId, 'CONTINUE');
 
+        // Other threads keep their own state
+        response.body = { allThreadsContinued: false };
         this.sendResponse(response);
     }
 
+    protected customRequest(command: string, response: DebugProtocol.Response, args: any, request?: DebugProtocol.Request): void {
+        if (command === 'gcCensus') {
+            // The result is streamed back as GC_CENSUS_PROGRESS and GC_CENSUS
+            this._clients.forEach(client => {
+                client.write('GC_CENSUS\n');
+            });
+
+            this.sendResponse(response);
+            return;
+        }
+
+        if (command === 'showMetrics') {
+            const report = this._lastMetrics !== '' ? this._lastMetrics : 'No debugger overhead metrics received yet.\n';
+            this.sendEvent(new OutputEvent(report, 'console'));
+            this.sendResponse(response);
+            return;
+        }
+
+        super.customRequest(command, response, args, request);
+    }
+
+    private sendCommand(threadId: number, command: string): void {
+        this._stops.delete(threadId);
+        this._clients.forEach(client => {
+            client.write(`COMMAND\n${threadId}\n${command}\n`);
+        });
+    }
+
     // protected evaluateRequest(response: DebugProtocol.EvaluateResponse, args: DebugProtocol.EvaluateArguments, request?: DebugProtocol.Request): void {
 
     // }
 
     protected scopesRequest(response: DebugProtocol.ScopesResponse, args: DebugProtocol.ScopesArguments, request?: DebugProtocol.Request): void {
+        // Only the locals of the top frame are known, referenced by the thread id
+        const threadId = Math.floor(args.frameId / frameIdsPerThread);
+        const isTopFrame = args.frameId % frameIdsPerThread === 0;
         response.body = {
-            scopes: [
+            scopes: isTopFrame ? [
                 {
-                    name: "my_function",
-                    variablesReference: 1000, // FIXME
+                    name: "Locals",
+                    variablesReference: threadId,
                     expensive: false
                 }
-            ]
+            ] : []
         };
 
         this.sendResponse(response);
     }
 
     protected variablesRequest(response: DebugProtocol.VariablesResponse, args: DebugProtocol.VariablesArguments, request?: DebugProtocol.Request): void {
+        const variables = this._stops.get(args.variablesReference)?.variables ?? [];
         response.body = {
-            variables: this._variables.map((v, i) => {
+            variables: variables.map(v => {
                 return {
                     name: v.name,
                     value: v.value,
-                    variablesReference: 2000 + i // FIXME
+                    variablesReference: 0
                 };
             })
         };